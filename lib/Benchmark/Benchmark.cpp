@@ -0,0 +1,101 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include "Benchmark.h"
+
+using namespace Benchmark;
+
+// Batches are grown until one takes at least this long, so that the clock
+// resolution and the call overhead do not show in the per-call times.
+static constexpr double minBatchNs = 1e6;
+
+static constexpr int minSamples = 5;
+static constexpr int maxSamples = 1000;
+
+Runner::Runner(double minTime, std::string filter)
+    : minTime(minTime), filter(std::move(filter))
+{
+}
+
+bool Runner::matches(const std::string & name) const
+{
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+void Runner::measure(const std::string & name, const Params & params, const std::function<void(long)> & batch)
+{
+    using namespace std::chrono;
+
+    auto time = [&](long n) {
+        const auto t1 = steady_clock::now();
+        batch(n);
+        const auto t2 = steady_clock::now();
+        return double(duration_cast<nanoseconds>(t2 - t1).count());
+    };
+
+    // Warm up caches, FFT plans and static buffers.
+    batch(1);
+
+    long n = 1;
+    double t = time(n);
+    while (t < minBatchNs && n < (1L << 30)) {
+        n *= std::clamp<long>(minBatchNs / std::max(t, 1.0), 2, 100);
+        t = time(n);
+    }
+
+    std::vector<double> samples{t / n};
+    double total = t;
+
+    while ((total < minTime * 1e9 || int(samples.size()) < minSamples) && int(samples.size()) < maxSamples) {
+        t = time(n);
+        samples.push_back(t / n);
+        total += t;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    const int count = samples.size();
+
+    Result result;
+    result.name = name;
+    result.params = params;
+    result.iterations = n * count;
+    result.minNs = samples.front();
+    result.medianNs = (count % 2) ? samples[count / 2] : 0.5 * (samples[count / 2 - 1] + samples[count / 2]);
+    result.meanNs = std::accumulate(samples.begin(), samples.end(), 0.0) / count;
+
+    std::cerr << name;
+    for (const auto & [key, value] : params) {
+        std::cerr << ' ' << key << '=' << value;
+    }
+    std::cerr << ": " << result.medianNs / 1000.0 << " us" << std::endl;
+
+    results.push_back(std::move(result));
+}
+
+void Runner::writeJson(std::ostream & out) const
+{
+    char buf[128];
+
+    out << "{\n  \"min_time_s\": " << minTime << ",\n  \"benchmarks\": [";
+
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result & r = results[i];
+
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << r.name << "\", \"params\": {";
+        for (std::size_t k = 0; k < r.params.size(); ++k) {
+            out << (k == 0 ? "" : ", ") << '"' << r.params[k].first << "\": " << r.params[k].second;
+        }
+        std::snprintf(buf, sizeof(buf), "}, \"iterations\": %ld, \"ns_per_op\": {\"min\": %.1f, \"median\": %.1f, \"mean\": %.1f}}",
+                      r.iterations, r.minNs, r.medianNs, r.meanNs);
+        out << buf;
+    }
+
+    out << "\n  ]\n}\n";
+}
@@ -0,0 +1,72 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_BENCHMARK_H
+#define SPEECH_ANALYSIS_BENCHMARK_H
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Benchmark {
+
+    // Ordered, so that the JSON output of two builds can be diffed line by line.
+    using Params = std::vector<std::pair<std::string, double>>;
+
+    struct Result {
+        std::string name;
+        Params params;
+        long iterations;
+        double minNs;
+        double medianNs;
+        double meanNs;
+    };
+
+    // Keeps the compiler from discarding a result that is never read.
+    template<typename T>
+    inline void doNotOptimize(const T & value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r"(&value) : "memory");
+#else
+        const volatile void * sink = &value;
+        (void) sink;
+#endif
+    }
+
+    class Runner {
+    public:
+        // Each case is sampled for at least `minTime` seconds. Only cases whose
+        // name contains `filter` are run.
+        Runner(double minTime, std::string filter);
+
+        [[nodiscard]] bool matches(const std::string & name) const;
+
+        // Times repeated calls to fn(), which must leave its inputs reusable.
+        template<typename Fn>
+        void run(const std::string & name, const Params & params, Fn && fn) {
+            if (!matches(name)) {
+                return;
+            }
+            measure(name, params, [&fn](long n) {
+                for (long i = 0; i < n; ++i) {
+                    fn();
+                }
+            });
+        }
+
+        void writeJson(std::ostream & out) const;
+
+    private:
+        void measure(const std::string & name, const Params & params, const std::function<void(long)> & batch);
+
+        double minTime;
+        std::string filter;
+        std::vector<Result> results;
+    };
+
+}
+
+#endif //SPEECH_ANALYSIS_BENCHMARK_H
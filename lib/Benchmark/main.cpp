@@ -0,0 +1,485 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include "Benchmark.h"
+#include "../FFT/ChirpZ.h"
+#include "../FFT/FFT.h"
+#include "../FFT/SlidingDFT.h"
+#include "../FFT/STFT.h"
+#include "../Formant/Formant.h"
+#include "../Formant/EKF/EKF.h"
+#include "../GCOI/GCOI.h"
+#include "../LPC/LPC.h"
+#include "../LPC/Frame/LPC_Frame.h"
+#include "../Math/Polynomial.h"
+#include "../Math/Viterbi.h"
+#include "../MFCC/MFCC.h"
+#include "../Pitch/Pitch.h"
+#include "../Pitch/DynamicWavelet.h"
+#include "../Signal/Autocorrelation.h"
+#include "../Signal/Resample.h"
+#include "../Signal/Window.h"
+
+using namespace Eigen;
+using Benchmark::Params;
+using Benchmark::Runner;
+using Benchmark::doNotOptimize;
+
+static const double sampleRates[] = {16000, 48000};
+static const double frameLengths[] = {25, 35, 50};
+
+// Sample rates the formant analysis sees after resampling to twice the maximum frequency.
+static const double lpSampleRates[] = {9400, 16000};
+static const int lpOrders[] = {10, 12, 16};
+
+// A fixed vowel: a 120 Hz pulse train through three formant resonators, with a little noise.
+static ArrayXd makeVowel(double fs, double durationMs)
+{
+    const int n = std::max(1, int(durationMs / 1000.0 * fs));
+
+    const double formants[][2] = {{700, 80}, {1220, 90}, {2600, 120}};
+
+    std::mt19937 gen(42);
+    std::normal_distribution<double> noise(0.0, 1e-3);
+
+    ArrayXd x(n);
+    const int period = std::round(fs / 120.0);
+    for (int i = 0; i < n; ++i) {
+        x(i) = (i % period == 0) ? 1.0 : 0.0;
+    }
+
+    for (const auto & [f, b] : formants) {
+        const double r = std::exp(-M_PI * b / fs);
+        const double c = 2 * r * std::cos(2 * M_PI * f / fs);
+        double y1 = 0, y2 = 0;
+        for (int i = 0; i < n; ++i) {
+            const double y = (1 - r) * x(i) + c * y1 - r * r * y2;
+            y2 = y1;
+            y1 = y;
+            x(i) = y;
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        x(i) += noise(gen);
+    }
+
+    return x / x.abs().maxCoeff();
+}
+
+static ArrayXd makeWindowedVowel(double fs, double durationMs)
+{
+    ArrayXd x = makeVowel(fs, durationMs);
+    return x * Window::createHamming(x.size());
+}
+
+static LPC::Frame lpcOf(const ArrayXd & x, int order)
+{
+    LPC::Frame lpc;
+    lpc.nCoefficients = order;
+    LPC::frame_burg(x, lpc);
+    return lpc;
+}
+
+static ArrayXd polynomialOf(const LPC::Frame & lpc)
+{
+    ArrayXd p(lpc.nCoefficients + 1);
+    p(0) = 1.0;
+    p.tail(lpc.nCoefficients) = lpc.a;
+    return p;
+}
+
+static void benchLpc(Runner & runner)
+{
+    for (double fs : lpSampleRates) {
+        for (double length : frameLengths) {
+            const ArrayXd x = makeWindowedVowel(fs, length);
+            const ArrayXf xf = x.cast<float>();
+
+            for (int order : lpOrders) {
+                const Params params{{"fs", fs}, {"length_ms", length}, {"order", order}};
+
+                LPC::Frame lpc;
+                lpc.nCoefficients = order;
+
+                runner.run("LPC::frame_auto", params, [&]() { LPC::frame_auto(x, lpc); doNotOptimize(lpc.a); });
+                runner.run("LPC::frame_covar", params, [&]() { LPC::frame_covar(x, lpc); doNotOptimize(lpc.a); });
+                runner.run("LPC::frame_burg", params, [&]() { LPC::frame_burg(x, lpc); doNotOptimize(lpc.a); });
+                runner.run("LPC::frame_burg<float>", params, [&]() { LPC::frame_burg(xf, lpc); doNotOptimize(lpc.a); });
+
+                // One point per row of a 512-pixel display.
+                LPC::frame_burg(x, lpc);
+                const ArrayXd frequencies = ArrayXd::LinSpaced(512, 0, fs / 2);
+                ArrayXd envelope(512);
+                runner.run("LPC::envelope", params, [&]() { LPC::envelope(lpc, frequencies, fs, envelope); doNotOptimize(envelope); });
+            }
+        }
+    }
+}
+
+static void benchRoots(Runner & runner)
+{
+    for (double fs : lpSampleRates) {
+        const ArrayXd x = makeWindowedVowel(fs, 35);
+
+        for (int order : {8, 10, 12, 16, 22}) {
+            const Params params{{"fs", fs}, {"order", order}};
+
+            const ArrayXd p = polynomialOf(lpcOf(x, order));
+            ArrayXcd r;
+
+            runner.run("Polynomial::roots", params, [&]() { Polynomial::roots(p, r); doNotOptimize(r); });
+
+            Polynomial::roots(p, r);
+            Polynomial::fixRootsIntoUnitCircle(r);
+            Formant::Frame frm;
+
+            runner.run("Formant::frameFromRoots", params, [&]() { Formant::frameFromRoots(p, r, frm, fs); doNotOptimize(frm); });
+        }
+    }
+}
+
+static void benchEkf(Runner & runner)
+{
+    for (double fs : lpSampleRates) {
+        const ArrayXd x = makeWindowedVowel(fs, 35);
+        const LPC::Frame lpc = lpcOf(x, 12);
+
+        for (int numF : {3, 4}) {
+            for (int cepOrder : {10, 15, 20}) {
+                const Params params{{"fs", fs}, {"formants", numF}, {"cep_order", cepOrder}};
+
+                VectorXd x0(2 * numF);
+                for (int k = 0; k < numF; ++k) {
+                    x0(k) = 550 + 600 * k;
+                    x0(numF + k) = 90 + 20 * k;
+                }
+
+                EKF::State state;
+                state.cepOrder = cepOrder;
+                EKF::init(state, x0);
+
+                const VectorXd cepstrum = EKF::genLPCC(lpc.a, cepOrder);
+
+                // The filter converges on the same frame, so every step does the same work.
+                runner.run("EKF::step", params, [&]() {
+                    state.y = cepstrum;
+                    state.voiced = true;
+                    state.fs = fs;
+                    EKF::step(state);
+                    doNotOptimize(state.m_up);
+                });
+            }
+        }
+    }
+}
+
+struct ViterbiCosts {
+    int ncand;
+    int ntrack;
+    std::vector<double> local;
+    std::vector<double> transition;
+    std::vector<int> places;
+};
+
+static void benchViterbi(Runner & runner)
+{
+    for (int nframe : {50, 200}) {
+        for (int ncand : {5, 7}) {
+            for (int ntrack : {3, 4}) {
+                const Params params{{"frames", nframe}, {"candidates", ncand}, {"tracks", ntrack}};
+
+                std::mt19937 gen(42);
+                std::uniform_real_distribution<double> cost(0.0, 1.0);
+
+                ViterbiCosts costs;
+                costs.ncand = ncand;
+                costs.ntrack = ntrack;
+                costs.local.resize(nframe * ncand);
+                costs.transition.resize(ncand * ncand);
+                costs.places.resize(nframe * ntrack);
+                for (auto & c : costs.local) c = cost(gen);
+                for (auto & c : costs.transition) c = cost(gen);
+
+                // Frames, candidates and tracks are numbered from 1.
+                auto localCost = [](int iframe, int icand, int itrack, void * closure) {
+                    auto c = static_cast<ViterbiCosts *>(closure);
+                    return c->local[(iframe - 1) * c->ncand + (icand - 1)] * itrack;
+                };
+                auto transitionCost = [](int iframe, int icand1, int icand2, int itrack, void * closure) {
+                    auto c = static_cast<ViterbiCosts *>(closure);
+                    return c->transition[(icand1 - 1) * c->ncand + (icand2 - 1)];
+                };
+                auto putResult = [](int iframe, int place, int itrack, void * closure) {
+                    auto c = static_cast<ViterbiCosts *>(closure);
+                    c->places[(iframe - 1) * c->ntrack + (itrack - 1)] = place;
+                };
+
+                runner.run("Viterbi::viterbiMulti", params, [&]() {
+                    Viterbi::viterbiMulti(nframe, ncand, ntrack, localCost, transitionCost, putResult, &costs);
+                    doNotOptimize(costs.places);
+                });
+            }
+        }
+    }
+}
+
+static void benchPitch(Runner & runner)
+{
+    for (double fs : sampleRates) {
+        for (double length : frameLengths) {
+            const Params params{{"fs", fs}, {"length_ms", length}};
+
+            const ArrayXd x = makeVowel(fs, length);
+            Pitch::Estimation est;
+
+            runner.run("Autocorrelation::compute", params, [&]() { ArrayXd r = Autocorrelation::compute(x); doNotOptimize(r); });
+            const ArrayXf xf = x.cast<float>();
+            runner.run("Autocorrelation::compute<float>", params, [&]() { ArrayXf r = Autocorrelation::compute(xf); doNotOptimize(r); });
+
+            const int n = x.size();
+
+            // Same parameters as the analysis engine.
+            Pitch::DynamicWavelet dynWav({fs, n, 0, 3000}, 6, 12, 0.35);
+            runner.run("Pitch::DynamicWavelet::estimate", params, [&]() { dynWav.estimate(x, est); doNotOptimize(est); });
+            Pitch::McLeodEstimator mpm({fs, n, 60, fs / 2});
+            runner.run("Pitch::McLeodEstimator::estimate", params, [&]() { mpm.estimate(x, est); doNotOptimize(est); });
+            Pitch::YinEstimator yin({fs, n, 60, fs / 2}, 0.10);
+            runner.run("Pitch::YinEstimator::estimate", params, [&]() { yin.estimate(x, est); doNotOptimize(est); });
+            Pitch::AmdfEstimator amdf({fs, n, 90, 1000}, 4.0, 0.1);
+            runner.run("Pitch::AmdfEstimator::estimate", params, [&]() { amdf.estimate(x, est); doNotOptimize(est); });
+
+            runner.run("Pitch::estimate_MPM", params, [&]() { Pitch::estimate_MPM(x, fs, est); doNotOptimize(est); });
+            runner.run("Pitch::estimate_YIN", params, [&]() { Pitch::estimate_YIN(x, fs, est, 0.10); doNotOptimize(est); });
+            runner.run("Pitch::estimate_YIN (time domain)", params, [&]() { Pitch::estimate_YIN(x, fs, est, 0.10, 60); doNotOptimize(est); });
+            runner.run("Pitch::estimate_AMDF", params, [&]() { Pitch::estimate_AMDF(x, fs, est, 90, 1000, 4.0, 0.1); doNotOptimize(est); });
+        }
+    }
+}
+
+static void benchGcoi(Runner & runner)
+{
+    for (double fs : sampleRates) {
+        for (double length : frameLengths) {
+            const Params params{{"fs", fs}, {"length_ms", length}};
+
+            const ArrayXd x = makeVowel(fs, length);
+
+            runner.run("GCOI::estimate_MultiProduct", params, [&]() {
+                auto pairs = GCOI::estimate_MultiProduct(x, fs, 3);
+                doNotOptimize(pairs);
+            });
+        }
+    }
+}
+
+static void benchMfcc(Runner & runner)
+{
+    for (double fs : sampleRates) {
+        for (double length : frameLengths) {
+            const Params params{{"fs", fs}, {"length_ms", length}};
+
+            const ArrayXd x = makeWindowedVowel(fs, length);
+            ArrayXd mfcc;
+
+            // mfccSignal uses a fixed 2048-point FFT.
+            if (x.size() > 2048) {
+                continue;
+            }
+
+            runner.run("MFCC::mfccSignal", params, [&]() { MFCC::mfccSignal(x, fs, 13, 26, 0, fs / 2, mfcc); doNotOptimize(mfcc); });
+        }
+    }
+}
+
+static void benchResample(Runner & runner)
+{
+    for (double fs : {16000.0, 44100.0, 48000.0}) {
+        for (double length : frameLengths) {
+            const ArrayXd x = makeVowel(fs, length);
+
+            for (int precision : {1, 10}) {
+                const Params params{{"fs", fs}, {"target_fs", 9400}, {"length_ms", length}, {"precision", precision}};
+
+                runner.run("Resample::resample", params, [&]() {
+                    ArrayXd y = Resample::resample(x, fs, 9400, precision);
+                    doNotOptimize(y);
+                });
+            }
+        }
+    }
+}
+
+#define BENCH_FFT(name, type, real) \
+    { \
+        FFTPlan<type, real> plan(n); \
+        for (int i = 0; i < plan.inSize(); ++i) plan.in()[i] = x(i); \
+        runner.run(#name, params, [&]() { plan.execute(); doNotOptimize(*plan.out()); }); \
+    }
+
+static void benchFft(Runner & runner)
+{
+    for (int n : {256, 512, 1024, 2048, 4096}) {
+        const Params params{{"n", n}};
+
+        const ArrayXd x = makeVowel(16000, 1000.0 * n / 16000);
+
+        BENCH_FFT(rfft, RFFT, double)
+        BENCH_FFT(irfft, IRFFT, double)
+        BENCH_FFT(rcfft, RCFFT, double)
+        BENCH_FFT(crfft, CRFFT, double)
+        BENCH_FFT(fft, CFFT, double)
+        BENCH_FFT(ifft, ICFFT, double)
+
+        BENCH_FFT(rfftf, RFFT, float)
+        BENCH_FFT(irfftf, IRFFT, float)
+        BENCH_FFT(rcfftf, RCFFT, float)
+        BENCH_FFT(crfftf, CRFFT, float)
+        BENCH_FFT(fftf, CFFT, float)
+        BENCH_FFT(ifftf, ICFFT, float)
+
+        // Zoomed spectrum of the same frame, as in the analysis engine.
+        const ArrayXf xf = x.head(n).cast<float>();
+        for (int m : {128, 256, 512}) {
+            const Params zoomParams{{"n", n}, {"bins", m}, {"max_freq", 4700}};
+            const ChirpZ chirpZ(n, m, 0.0, 4700.0 / m, 16000);
+            ArrayXcf X;
+            runner.run("ChirpZ::transform", zoomParams, [&]() { chirpZ.transform(xf, X); doNotOptimize(X); });
+        }
+    }
+}
+
+static void benchStft(Runner & runner)
+{
+    // One second at 16 kHz, 15 ms hop.
+    const ArrayXf x = makeVowel(16000, 1000).cast<float>();
+    const int hop = 240;
+
+    for (int n : {512, 1024}) {
+        const int numFrames = (x.size() - n) / hop + 1;
+
+        for (int batchSize : {1, 8, 32}) {
+            const Params params{{"n", n}, {"hop", hop}, {"batch", batchSize}};
+
+            STFT stft(n, hop, batchSize);
+            ArrayXXf magnitude;
+            runner.run("STFT::compute", params, [&]() { stft.compute(x, 0, numFrames, magnitude); doNotOptimize(magnitude); });
+        }
+    }
+}
+
+static void benchSlidingDft(Runner & runner)
+{
+    // Bins up to 4700 Hz at 16 kHz, as in the analysis engine.
+    const ArrayXf x = makeVowel(16000, 1000).cast<float>();
+
+    for (int n : {512, 1024, 2048}) {
+        const int m = std::ceil(4700.0 * n / 16000) + 1;
+
+        for (int hop : {80, 240}) {
+            const Params params{{"n", n}, {"bins", m}, {"hop", hop}};
+
+            SlidingDFT sdft(n, m, 16000);
+            ArrayXd power;
+            int end = n;
+
+            sdft.update(x.head(n), 0);
+
+            runner.run("SlidingDFT::update", params, [&]() {
+                end = end + hop <= x.size() ? end + hop : n;
+                sdft.update(x.segment(end - n, n), end == n ? 0 : hop);
+                sdft.power(power);
+                doNotOptimize(power);
+            });
+        }
+    }
+}
+
+static void usage(const char * argv0)
+{
+    std::cerr <<
+        "Usage: " << argv0 << " [options]\n"
+        "\n"
+        "Times the libspeech kernels over synthetic vowel frames and writes the results as JSON.\n"
+        "\n"
+        "Options:\n"
+        "  -o, --output FILE    write the JSON to FILE instead of standard output\n"
+        "  --filter TEXT        only run kernels whose name contains TEXT\n"
+        "  --min-time S         minimum sampling time per case in seconds (default: 0.1)\n";
+}
+
+int main(int argc, char * argv[])
+{
+    std::string output;
+    std::string filter;
+    double minTime = 0.1;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument("missing value for " + arg);
+                }
+                return argv[++i];
+            };
+
+            if (arg == "-o" || arg == "--output") {
+                output = value();
+            }
+            else if (arg == "--filter") {
+                filter = value();
+            }
+            else if (arg == "--min-time") {
+                minTime = std::stod(value());
+            }
+            else {
+                usage(argv[0]);
+                return arg == "-h" || arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+        }
+    }
+    catch (const std::exception & e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Runner runner(minTime, filter);
+
+    benchLpc(runner);
+    benchRoots(runner);
+    benchEkf(runner);
+    benchViterbi(runner);
+    benchPitch(runner);
+    benchGcoi(runner);
+    benchMfcc(runner);
+    benchResample(runner);
+    benchFft(runner);
+    benchStft(runner);
+    benchSlidingDft(runner);
+
+    if (output.empty()) {
+        runner.writeJson(std::cout);
+    }
+    else {
+        std::ofstream file(output);
+        if (!file) {
+            std::cerr << argv[0] << ": unable to open " << output << std::endl;
+            return EXIT_FAILURE;
+        }
+        runner.writeJson(file);
+    }
+
+    all_fft_cleanup();
+
+    return EXIT_SUCCESS;
+}
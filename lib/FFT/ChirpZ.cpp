@@ -0,0 +1,66 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <cmath>
+#include "ChirpZ.h"
+#include "FFT.h"
+#include "../Signal/Autocorrelation.h"
+
+using namespace Eigen;
+
+// exp(j phase), with the phase reduced in double precision first.
+static std::complex<float> unit(double phase)
+{
+    phase = std::remainder(phase, 2 * M_PI);
+    return {float(std::cos(phase)), float(std::sin(phase))};
+}
+
+ChirpZ::ChirpZ(int n, int m, double start, double step, double fs)
+    : n(n),
+      m(m),
+      nfft(Autocorrelation::fastSize(n + m - 1)),
+      pre(n),
+      post(m),
+      kernel(nfft)
+{
+    // X(k) = sum_i x(i) exp(-j (a i + b i k)) with i k = (i^2 + k^2 - (k - i)^2) / 2.
+    const double a = 2 * M_PI * start / fs;
+    const double b = 2 * M_PI * step / fs;
+
+    for (int i = 0; i < n; ++i) {
+        pre(i) = unit(-a * i - b * i * i / 2);
+    }
+    for (int k = 0; k < m; ++k) {
+        post(k) = unit(-b * k * k / 2);
+    }
+
+    auto & plan = fft_cached_plan<CFFT, float>(nfft);
+
+    plan.input().setZero();
+    for (int k = 0; k < m; ++k) {
+        plan.in()[k] = unit(b * k * k / 2);
+    }
+    for (int i = 1; i < n; ++i) {
+        plan.in()[nfft - i] = unit(b * i * i / 2);
+    }
+
+    plan.execute();
+
+    kernel = plan.output() / float(nfft);
+}
+
+void ChirpZ::transform(const Ref<const ArrayXf> & x, ArrayXcf & X) const
+{
+    auto & forward = fft_cached_plan<CFFT, float>(nfft);
+    auto & backward = fft_cached_plan<ICFFT, float>(nfft);
+
+    forward.input().head(n) = x.head(n) * pre;
+    forward.input().tail(nfft - n).setZero();
+    forward.execute();
+
+    backward.input() = forward.output() * kernel;
+    backward.execute();
+
+    X = backward.output().head(m) * post;
+}
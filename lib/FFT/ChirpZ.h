@@ -0,0 +1,41 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_CHIRPZ_H
+#define SPEECH_ANALYSIS_CHIRPZ_H
+
+#include <Eigen/Core>
+
+// Chirp-z transform along the unit circle (Bluestein's algorithm): the DTFT
+// of n samples at m equally spaced frequencies anywhere in the band, with
+// m independent of n. It costs two complex FFTs of at least n + m - 1 points.
+//
+// The chirps are computed once, so a single ChirpZ can be shared between
+// threads; each thread transforms with its own cached plans.
+
+class ChirpZ {
+public:
+    // Frequencies start, start + step, ... in Hz, for samples at fs.
+    ChirpZ(int n, int m, double start, double step, double fs);
+
+    [[nodiscard]] int inputSize() const noexcept { return n; }
+    [[nodiscard]] int outputSize() const noexcept { return m; }
+    [[nodiscard]] int fftSize() const noexcept { return nfft; }
+
+    // x must hold inputSize() samples.
+    void transform(const Eigen::Ref<const Eigen::ArrayXf> & x, Eigen::ArrayXcf & X) const;
+
+private:
+    int n;
+    int m;
+    int nfft;
+
+    // Modulation of the input, of the output, and the spectrum of the
+    // convolution kernel scaled by 1 / nfft.
+    Eigen::ArrayXcf pre;
+    Eigen::ArrayXcf post;
+    Eigen::ArrayXcf kernel;
+};
+
+#endif //SPEECH_ANALYSIS_CHIRPZ_H
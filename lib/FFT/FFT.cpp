@@ -3,52 +3,297 @@
 //
 
 #include "FFT.h"
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
 #include <map>
+#include <mutex>
+#include <new>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
 
-using Eigen::dcomplex;
+// Guards the FFTW planner and wisdom, which are not thread-safe.
+static std::mutex plannerLock;
 
-#define DECL_IN(name, type, s_var) type * name##_in(int n) { return s_var.find(n)->second.in; }
-#define DECL_OUT(name, type, s_var) type * name##_out(int n) { return s_var.find(n)->second.out; }
+static std::atomic<FFTPlanning> planning(FFTPlanEstimate);
 
-#define DECL_PLAN(name, s_var, plan_call) \
-    void name##_plan(int n) { \
-        fftw_set_timelimit(FFT_PLAN_TIMELIMIT); \
-        auto it = s_var.find(n); \
-        if (it == s_var.end()) { \
-             auto s = decltype(it->second)(n); \
-             s.plan = plan_call; \
-             s_var[n] = std::move(s); \
-        } \
+static unsigned planFlags()
+{
+    switch (planning.load(std::memory_order_relaxed)) {
+        case FFTPlanMeasure:
+            return FFTW_MEASURE;
+        case FFTPlanPatient:
+            return FFTW_PATIENT;
+        default:
+            return FFTW_ESTIMATE;
+    }
+}
+
+#define DECL_FFTW_API(X, real) \
+    template<FFTType type> \
+    static X##_plan makePlan(int n, typename fft_types<type, real>::in * in, typename fft_types<type, real>::out * out, unsigned flags) \
+    { \
+        X##_set_timelimit(FFT_PLAN_TIMELIMIT); \
+        if constexpr (type == RFFT) \
+            return X##_plan_r2r_1d(n, in, out, FFTW_REDFT10, flags); \
+        else if constexpr (type == IRFFT) \
+            return X##_plan_r2r_1d(n, in, out, FFTW_REDFT01, flags); \
+        else if constexpr (type == RCFFT) \
+            return X##_plan_dft_r2c_1d(n, in, (X##_complex *) out, flags); \
+        else if constexpr (type == CRFFT) \
+            return X##_plan_dft_c2r_1d(n, (X##_complex *) in, out, flags); \
+        else if constexpr (type == CFFT) \
+            return X##_plan_dft_1d(n, (X##_complex *) in, (X##_complex *) out, FFTW_FORWARD, flags); \
+        else \
+            return X##_plan_dft_1d(n, (X##_complex *) in, (X##_complex *) out, FFTW_BACKWARD, flags); \
+    } \
+    static void * allocate(real *, std::size_t size) { return X##_malloc(size); } \
+    static void deallocate(real *, void * p) { X##_free(p); } \
+    static void destroyPlan(X##_plan p) { X##_destroy_plan(p); } \
+    static void executePlan(X##_plan p) { X##_execute(p); } \
+    static void executePlan(X##_plan p, real * in, real * out) { X##_execute_r2r(p, in, out); } \
+    static void executePlan(X##_plan p, real * in, std::complex<real> * out) { X##_execute_dft_r2c(p, in, (X##_complex *) out); } \
+    static void executePlan(X##_plan p, std::complex<real> * in, real * out) { X##_execute_dft_c2r(p, (X##_complex *) in, out); } \
+    static void executePlan(X##_plan p, std::complex<real> * in, std::complex<real> * out) { X##_execute_dft(p, (X##_complex *) in, (X##_complex *) out); }
+
+DECL_FFTW_API(fftw, double)
+DECL_FFTW_API(fftwf, float)
+
+template<FFTType type, typename Real>
+FFTPlan<type, Real>::FFTPlan(int n)
+    : n(n),
+      inBuf((in_type *) allocate((Real *) nullptr, inSize() * sizeof(in_type))),
+      outBuf((out_type *) allocate((Real *) nullptr, outSize() * sizeof(out_type))),
+      plan(nullptr)
+{
+    if (inBuf != nullptr && outBuf != nullptr) {
+        std::lock_guard<std::mutex> lock(plannerLock);
+        plan = makePlan<type>(n, inBuf, outBuf, planFlags());
+    }
+
+    if (plan == nullptr) {
+        release();
+        throw std::bad_alloc();
+    }
+}
+
+template<FFTType type, typename Real>
+FFTPlan<type, Real>::~FFTPlan()
+{
+    release();
+}
+
+template<FFTType type, typename Real>
+FFTPlan<type, Real>::FFTPlan(FFTPlan && other) noexcept
+    : n(other.n), inBuf(other.inBuf), outBuf(other.outBuf), plan(other.plan)
+{
+    other.n = 0;
+    other.inBuf = nullptr;
+    other.outBuf = nullptr;
+    other.plan = nullptr;
+}
+
+template<FFTType type, typename Real>
+FFTPlan<type, Real> & FFTPlan<type, Real>::operator=(FFTPlan && other) noexcept
+{
+    if (this != &other) {
+        release();
+        n = other.n;
+        inBuf = other.inBuf;
+        outBuf = other.outBuf;
+        plan = other.plan;
+        other.n = 0;
+        other.inBuf = nullptr;
+        other.outBuf = nullptr;
+        other.plan = nullptr;
+    }
+    return *this;
+}
+
+template<FFTType type, typename Real>
+void FFTPlan<type, Real>::release() noexcept
+{
+    if (plan != nullptr) {
+        std::lock_guard<std::mutex> lock(plannerLock);
+        destroyPlan(plan);
+        plan = nullptr;
+    }
+    if (inBuf != nullptr) {
+        deallocate((Real *) nullptr, inBuf);
+        inBuf = nullptr;
+    }
+    if (outBuf != nullptr) {
+        deallocate((Real *) nullptr, outBuf);
+        outBuf = nullptr;
+    }
+}
+
+template<FFTType type, typename Real>
+void FFTPlan<type, Real>::execute() noexcept
+{
+    executePlan(plan);
+}
+
+template<FFTType type, typename Real>
+void FFTPlan<type, Real>::execute(in_type * in, out_type * out) const noexcept
+{
+    executePlan(plan, in, out);
+}
+
+template<FFTType type, typename Real>
+static std::map<int, FFTPlan<type, Real>> & planCache()
+{
+    static thread_local std::map<int, FFTPlan<type, Real>> cache;
+    return cache;
+}
+
+template<FFTType type, typename Real>
+FFTPlan<type, Real> & fft_cached_plan(int n)
+{
+    auto & cache = planCache<type, Real>();
+    auto it = cache.find(n);
+    if (it == cache.end()) {
+        it = cache.emplace(n, FFTPlan<type, Real>(n)).first;
     }
+    return it->second;
+}
+
+#define INSTANTIATE_FFT(type, real) \
+    template class FFTPlan<type, real>; \
+    template FFTPlan<type, real> & fft_cached_plan<type, real>(int n);
+
+INSTANTIATE_FFT(RFFT, double)
+INSTANTIATE_FFT(IRFFT, double)
+INSTANTIATE_FFT(RCFFT, double)
+INSTANTIATE_FFT(CRFFT, double)
+INSTANTIATE_FFT(CFFT, double)
+INSTANTIATE_FFT(ICFFT, double)
+
+INSTANTIATE_FFT(RFFT, float)
+INSTANTIATE_FFT(IRFFT, float)
+INSTANTIATE_FFT(RCFFT, float)
+INSTANTIATE_FFT(CRFFT, float)
+INSTANTIATE_FFT(CFFT, float)
+INSTANTIATE_FFT(ICFFT, float)
 
-#define DECL_EXEC(name, s_var) \
-    void name(int n) { \
-        fftw_execute(s_var.find(n)->second.plan); \
+#define DECL_FFT_IMPL(name, type, real) \
+    fft_types<type, real>::in * name##_in(int n) { return fft_cached_plan<type, real>(n).in(); } \
+    fft_types<type, real>::out * name##_out(int n) { return fft_cached_plan<type, real>(n).out(); } \
+    void name##_plan(int n) { fft_cached_plan<type, real>(n); } \
+    void name(int n) { fft_cached_plan<type, real>(n).execute(); }
+
+DECL_FFT_IMPL(rfft, RFFT, double)
+DECL_FFT_IMPL(irfft, IRFFT, double)
+DECL_FFT_IMPL(rcfft, RCFFT, double)
+DECL_FFT_IMPL(crfft, CRFFT, double)
+DECL_FFT_IMPL(fft, CFFT, double)
+DECL_FFT_IMPL(ifft, ICFFT, double)
+
+DECL_FFT_IMPL(rfftf, RFFT, float)
+DECL_FFT_IMPL(irfftf, IRFFT, float)
+DECL_FFT_IMPL(rcfftf, RCFFT, float)
+DECL_FFT_IMPL(crfftf, CRFFT, float)
+DECL_FFT_IMPL(fftf, CFFT, float)
+DECL_FFT_IMPL(ifftf, ICFFT, float)
+
+void fft_set_planning(FFTPlanning _planning)
+{
+    planning.store(_planning, std::memory_order_relaxed);
+}
+
+FFTPlanning fft_get_planning()
+{
+    return planning.load(std::memory_order_relaxed);
+}
+
+unsigned fft_planner_flags()
+{
+    return planFlags();
+}
+
+std::mutex & fft_planner_lock()
+{
+    return plannerLock;
+}
+
+static std::string cpuName()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (__get_cpuid_max(0x80000000, nullptr) >= 0x80000004) {
+        unsigned int brand[12];
+        for (unsigned int i = 0; i < 3; ++i) {
+            __get_cpuid(0x80000002 + i, &brand[4 * i], &brand[4 * i + 1], &brand[4 * i + 2], &brand[4 * i + 3]);
+        }
+        return std::string(reinterpret_cast<const char *>(brand), sizeof(brand)).c_str();
+    }
+#endif
+
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.rfind("model name", 0) == 0 || line.rfind("Hardware", 0) == 0) {
+            return line.substr(line.find(':') + 1);
+        }
+    }
+
+    return "unknown";
+}
+
+std::string fft_wisdom_path(const std::string & directory)
+{
+    std::string version;
+    for (const char * c = fftw_version; *c != '\0'; ++c) {
+        version += std::isalnum((unsigned char) *c) || *c == '.' ? *c : '-';
     }
 
-#define DECL_FFT_IMPL(name, inType, outType, plan_call) \
-    static std::map<int, fft_s<inType, outType>> s_##name; \
-    DECL_IN(name, inType, s_##name) \
-    DECL_OUT(name, outType, s_##name) \
-    DECL_PLAN(name, s_##name, plan_call) \
-    DECL_EXEC(name, s_##name)
+    // FNV-1a, which is stable from one build to the next, unlike std::hash.
+    std::uint64_t hash = 14695981039346656037ull;
+    for (char c : cpuName()) {
+        hash = (hash ^ (unsigned char) c) * 1099511628211ull;
+    }
 
-DECL_FFT_IMPL(rfft, double, double, fftw_plan_r2r_1d(n, s.in, s.out, FFTW_REDFT10, FFTW_ESTIMATE))
-DECL_FFT_IMPL(irfft, double, double, fftw_plan_r2r_1d(n, s.in, s.out, FFTW_REDFT01, FFTW_ESTIMATE))
+    char name[96];
+    std::snprintf(name, sizeof(name), "%s-%016llx.wisdom", version.c_str(), (unsigned long long) hash);
 
-DECL_FFT_IMPL(rcfft, double, dcomplex, fftw_plan_dft_r2c_1d(n, s.in, (fftw_complex *) s.out, FFTW_ESTIMATE))
-DECL_FFT_IMPL(crfft, dcomplex, double, fftw_plan_dft_c2r_1d(n, (fftw_complex *) s.in, s.out, FFTW_ESTIMATE))
+    return directory.empty() ? name : directory + "/" + name;
+}
 
-DECL_FFT_IMPL(fft, dcomplex, dcomplex, fftw_plan_dft_1d(n, (fftw_complex *) s.in, (fftw_complex *) s.out, FFTW_FORWARD, FFTW_ESTIMATE))
-DECL_FFT_IMPL(ifft, dcomplex, dcomplex, fftw_plan_dft_1d(n, (fftw_complex *) s.in, (fftw_complex *) s.out, FFTW_BACKWARD, FFTW_ESTIMATE))
+bool fft_load_wisdom(const std::string & path)
+{
+    std::lock_guard<std::mutex> lock(plannerLock);
+    const bool loaded = fftw_import_wisdom_from_filename(path.c_str()) != 0;
+    const bool loadedFloat = fftwf_import_wisdom_from_filename((path + ".float").c_str()) != 0;
+    return loaded && loadedFloat;
+}
+
+bool fft_save_wisdom(const std::string & path)
+{
+    std::lock_guard<std::mutex> lock(plannerLock);
+    const bool saved = fftw_export_wisdom_to_filename(path.c_str()) != 0;
+    const bool savedFloat = fftwf_export_wisdom_to_filename((path + ".float").c_str()) != 0;
+    return saved && savedFloat;
+}
 
 void all_fft_cleanup()
 {
-    s_rfft.clear();
-    s_irfft.clear();
-    s_rcfft.clear();
-    s_crfft.clear();
-    s_fft.clear();
-    s_ifft.clear();
+    planCache<RFFT, double>().clear();
+    planCache<IRFFT, double>().clear();
+    planCache<RCFFT, double>().clear();
+    planCache<CRFFT, double>().clear();
+    planCache<CFFT, double>().clear();
+    planCache<ICFFT, double>().clear();
+
+    planCache<RFFT, float>().clear();
+    planCache<IRFFT, float>().clear();
+    planCache<RCFFT, float>().clear();
+    planCache<CRFFT, float>().clear();
+    planCache<CFFT, float>().clear();
+    planCache<ICFFT, float>().clear();
+
+    std::lock_guard<std::mutex> lock(plannerLock);
     fftw_cleanup();
+    fftwf_cleanup();
 }
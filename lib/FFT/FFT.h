@@ -7,64 +7,161 @@
 
 #include <Eigen/Core>
 #include <fftw3.h>
+#include <complex>
+#include <mutex>
+#include <string>
+#include <type_traits>
 
-template<typename T1, typename T2>
-class fft_s {
-public:
-    int n;
-    T1 * in;
-    T2 * out;
-    fftw_plan plan;
+enum FFTType {
+    RFFT,   // DCT-II (REDFT10)
+    IRFFT,  // DCT-III (REDFT01)
+    RCFFT,  // real to half-complex
+    CRFFT,  // half-complex to real
+    CFFT,   // complex forward
+    ICFFT,  // complex backward
+};
+
+template<typename Real> struct fftw_types;
+template<> struct fftw_types<double> { using plan = fftw_plan; };
+template<> struct fftw_types<float>  { using plan = fftwf_plan; };
 
+// Sample types of each transform, in double or single precision.
+template<FFTType type, typename Real = double>
+struct fft_types {
+    using in = std::conditional_t<type == CRFFT || type == CFFT || type == ICFFT, std::complex<Real>, Real>;
+    using out = std::conditional_t<type == RCFFT || type == CFFT || type == ICFFT, std::complex<Real>, Real>;
+};
+
+// An FFTW plan of a given size along with its own aligned input and output
+// buffers, in double precision (fftw) or single precision (fftwf). Plans are
+// created and destroyed under a global lock, since the FFTW planner is not
+// thread-safe, but executing them is: a thread may run its plans
+// concurrently with any other thread's.
+//
+// Real-to-complex transforms of size n have n / 2 + 1 complex outputs, and
+// complex-to-real transforms as many complex inputs. Complex-to-real
+// transforms overwrite their input.
+template<FFTType type, typename Real = double>
+class FFTPlan {
 public:
-    fft_s() : n(-1), plan(nullptr), in(nullptr), out(nullptr) {}
-    fft_s(int n)
-            : n(n), in((T1 *) fftw_malloc(n * sizeof(T1))),
-              out((T2 *) fftw_malloc(n * sizeof(T2))) {
-    }
-    ~fft_s() {
-        if (n > 0) {
-            if (plan != nullptr) fftw_destroy_plan(plan);
-            if (in != nullptr) fftw_free(in);
-            if (out != nullptr) fftw_free(out);
-        }
-    }
-
-    fft_s & operator=(const fft_s & other) noexcept {
-        this->~fft_s();
-        n = other.n;
-        plan = other.plan;
-        in = other.in;
-        out = other.out;
-        return *this;
-    }
-
-    fft_s & operator=(fft_s && other) noexcept {
-        *this = (const fft_s &) other;
-        other.n = -1;
-        other.plan = nullptr;
-        other.in = nullptr;
-        other.out = nullptr;
-        return *this;
-    }
+    using in_type = typename fft_types<type, Real>::in;
+    using out_type = typename fft_types<type, Real>::out;
+
+    explicit FFTPlan(int n);
+    ~FFTPlan();
+
+    FFTPlan(FFTPlan && other) noexcept;
+    FFTPlan & operator=(FFTPlan && other) noexcept;
+
+    FFTPlan(const FFTPlan &) = delete;
+    FFTPlan & operator=(const FFTPlan &) = delete;
+
+    [[nodiscard]] int size() const noexcept { return n; }
+    [[nodiscard]] int inSize() const noexcept { return type == CRFFT ? n / 2 + 1 : n; }
+    [[nodiscard]] int outSize() const noexcept { return type == RCFFT ? n / 2 + 1 : n; }
+
+    in_type * in() noexcept { return inBuf; }
+    out_type * out() noexcept { return outBuf; }
+
+    Eigen::Map<Eigen::Array<in_type, Eigen::Dynamic, 1>> input() noexcept { return {inBuf, inSize()}; }
+    Eigen::Map<Eigen::Array<out_type, Eigen::Dynamic, 1>> output() noexcept { return {outBuf, outSize()}; }
+
+    // Transforms the plan's own input buffer into its output buffer.
+    void execute() noexcept;
+
+    // Transforms other arrays of the plan's sizes. They must not overlap and
+    // must be allocated with fftw_malloc, like the plan's own buffers.
+    void execute(in_type * in, out_type * out) const noexcept;
+
+private:
+    void release() noexcept;
+
+    int n;
+    in_type * inBuf;
+    out_type * outBuf;
+    typename fftw_types<Real>::plan plan;
 };
 
+using RFFTPlan = FFTPlan<RFFT>;
+using IRFFTPlan = FFTPlan<IRFFT>;
+using RCFFTPlan = FFTPlan<RCFFT>;
+using CRFFTPlan = FFTPlan<CRFFT>;
+using CFFTPlan = FFTPlan<CFFT>;
+using ICFFTPlan = FFTPlan<ICFFT>;
+
+using RFFTFPlan = FFTPlan<RFFT, float>;
+using IRFFTFPlan = FFTPlan<IRFFT, float>;
+using RCFFTFPlan = FFTPlan<RCFFT, float>;
+using CRFFTFPlan = FFTPlan<CRFFT, float>;
+using CFFTFPlan = FFTPlan<CFFT, float>;
+using ICFFTFPlan = FFTPlan<ICFFT, float>;
+
 // 0.5 seconds
 #define FFT_PLAN_TIMELIMIT (0.5)
 
-#define DECL_FFT(name, inType, outType) \
-    inType * name##_in(int n); \
-    outType * name##_out(int n); \
+// How much time FFTW spends looking for a fast plan, up to FFT_PLAN_TIMELIMIT
+// per plan. Measured plans are only worth it together with saved wisdom.
+enum FFTPlanning {
+    FFTPlanEstimate = 0,
+    FFTPlanMeasure,
+    FFTPlanPatient,
+};
+
+// Applies to the plans created from now on.
+void fft_set_planning(FFTPlanning planning);
+FFTPlanning fft_get_planning();
+
+// For plans made outside FFTPlan: the FFTW planner flags of the current
+// planning mode, and the lock to hold while creating or destroying them.
+unsigned fft_planner_flags();
+std::mutex & fft_planner_lock();
+
+// Creates and drops a plan. The planning result stays in FFTW's wisdom, so
+// plans of that size created later, on any thread, skip the search.
+template<FFTType type, typename Real = double>
+void fft_prepare(int n) {
+    FFTPlan<type, Real> plan(n);
+}
+
+// Wisdom only holds for the CPU and FFTW build it was measured with, so the
+// cache file in `directory` is named after both.
+std::string fft_wisdom_path(const std::string & directory);
+
+// Both return false if the file could not be read or written. Single
+// precision wisdom goes to a second file, with ".float" appended to the path.
+bool fft_load_wisdom(const std::string & path);
+bool fft_save_wisdom(const std::string & path);
+
+// The calling thread's plan of size n, created on first use. Since each
+// thread has its own cache, threads never share buffers.
+template<FFTType type, typename Real = double>
+FFTPlan<type, Real> & fft_cached_plan(int n);
+
+// Shorthand over the per-thread cache of plans: name_plan(n)
+// creates the plan if needed, name_in(n) and name_out(n) return its buffers,
+// and name(n) executes it. The names ending in f are single precision.
+#define DECL_FFT(name, type, real) \
+    fft_types<type, real>::in * name##_in(int n); \
+    fft_types<type, real>::out * name##_out(int n); \
     void name##_plan(int n); \
     void name(int n);
 
-DECL_FFT(rfft, double, double)
-DECL_FFT(irfft, double, double)
-DECL_FFT(rcfft, double, Eigen::dcomplex)
-DECL_FFT(crfft, Eigen::dcomplex, double)
-DECL_FFT(fft, Eigen::dcomplex, Eigen::dcomplex)
-DECL_FFT(ifft, Eigen::dcomplex, Eigen::dcomplex)
+DECL_FFT(rfft, RFFT, double)
+DECL_FFT(irfft, IRFFT, double)
+DECL_FFT(rcfft, RCFFT, double)
+DECL_FFT(crfft, CRFFT, double)
+DECL_FFT(fft, CFFT, double)
+DECL_FFT(ifft, ICFFT, double)
+
+DECL_FFT(rfftf, RFFT, float)
+DECL_FFT(irfftf, IRFFT, float)
+DECL_FFT(rcfftf, RCFFT, float)
+DECL_FFT(crfftf, CRFFT, float)
+DECL_FFT(fftf, CFFT, float)
+DECL_FFT(ifftf, ICFFT, float)
 
+// Drops the calling thread's cached plans and releases FFTW's internal
+// state. Only call this once no other thread holds a plan.
 void all_fft_cleanup();
 
 #endif //SPEECH_ANALYSIS_FFT_H
@@ -0,0 +1,97 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include "STFT.h"
+#include "FFT.h"
+#include "../Signal/Window.h"
+
+using namespace Eigen;
+
+STFT::STFT(int nfft, int hop, int batchSize)
+    : nfft(nfft),
+      hop(hop),
+      batchSize(batchSize),
+      window(Window::createHanning(nfft).cast<float>()),
+      in((float *) fftwf_malloc(batchSize * nfft * sizeof(float))),
+      out((std::complex<float> *) fftwf_malloc(batchSize * getBinCount() * sizeof(std::complex<float>))),
+      plan(nullptr)
+{
+    if (in != nullptr && out != nullptr) {
+        const int nbins = getBinCount();
+
+        std::lock_guard<std::mutex> lock(fft_planner_lock());
+        fftwf_set_timelimit(FFT_PLAN_TIMELIMIT);
+        plan = fftwf_plan_many_dft_r2c(1, &nfft, batchSize,
+                                       in, nullptr, 1, nfft,
+                                       (fftwf_complex *) out, nullptr, 1, nbins,
+                                       fft_planner_flags());
+    }
+
+    if (plan == nullptr) {
+        fftwf_free(in);
+        fftwf_free(out);
+        if (in == nullptr || out == nullptr) {
+            throw std::bad_alloc();
+        }
+        throw std::runtime_error("fftwf_plan_many_dft_r2c failed");
+    }
+}
+
+STFT::~STFT()
+{
+    {
+        std::lock_guard<std::mutex> lock(fft_planner_lock());
+        fftwf_destroy_plan(plan);
+    }
+    fftwf_free(in);
+    fftwf_free(out);
+}
+
+void STFT::setWindow(const ArrayXf & _window)
+{
+    window = _window;
+}
+
+void STFT::compute(const ArrayXf & x, int offset, int numFrames, ArrayXXf & magnitude, ArrayXXf * phase)
+{
+    const int length = x.size();
+    const int nbins = getBinCount();
+
+    magnitude.resize(nbins, numFrames);
+    if (phase != nullptr) {
+        phase->resize(nbins, numFrames);
+    }
+
+    Map<ArrayXXf> frames(in, nfft, batchSize);
+    Map<ArrayXXcf> spectra(out, nbins, batchSize);
+
+    for (int first = 0; first < numFrames; first += batchSize) {
+        const int count = std::min(batchSize, numFrames - first);
+
+        for (int k = 0; k < count; ++k) {
+            const int start = offset + (first + k) * hop;
+            const int begin = std::clamp(-start, 0, nfft);
+            const int end = std::clamp(length - start, begin, nfft);
+
+            auto frame = frames.col(k);
+            frame.head(begin).setZero();
+            frame.segment(begin, end - begin) = x.segment(start + begin, end - begin) * window.segment(begin, end - begin);
+            frame.tail(nfft - end).setZero();
+        }
+
+        // The unused frames of the last block are transformed too, which
+        // costs less than a second plan.
+        frames.rightCols(batchSize - count).setZero();
+
+        fftwf_execute(plan);
+
+        magnitude.middleCols(first, count) = spectra.leftCols(count).abs();
+        if (phase != nullptr) {
+            phase->middleCols(first, count) = spectra.leftCols(count).arg();
+        }
+    }
+}
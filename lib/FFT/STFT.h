@@ -0,0 +1,51 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_STFT_H
+#define SPEECH_ANALYSIS_STFT_H
+
+#include <Eigen/Core>
+#include <complex>
+#include <fftw3.h>
+
+// Short-time Fourier transform of a whole signal, for offline spectrograms.
+//
+// Frames of nfft samples, hop samples apart, are windowed into a block of
+// `batchSize` frames which a single fftwf_plan_many_dft_r2c transforms at
+// once. Results are written frame by frame into a bins x frames matrix, so
+// that each frame's nfft / 2 + 1 bins are contiguous.
+
+class STFT {
+public:
+    STFT(int nfft, int hop, int batchSize = 32);
+    ~STFT();
+
+    STFT(const STFT &) = delete;
+    STFT & operator=(const STFT &) = delete;
+
+    // Hanning by default.
+    void setWindow(const Eigen::ArrayXf & window);
+
+    [[nodiscard]] int getFftSize() const noexcept { return nfft; }
+    [[nodiscard]] int getHop() const noexcept { return hop; }
+    [[nodiscard]] int getBinCount() const noexcept { return nfft / 2 + 1; }
+
+    // Frame k covers x(offset + k * hop) to x(offset + k * hop + nfft - 1).
+    // Samples outside of x are taken as zero, so offset may be negative.
+    // `phase` is optional.
+    void compute(const Eigen::ArrayXf & x, int offset, int numFrames,
+                 Eigen::ArrayXXf & magnitude, Eigen::ArrayXXf * phase = nullptr);
+
+private:
+    int nfft;
+    int hop;
+    int batchSize;
+    Eigen::ArrayXf window;
+
+    float * in;
+    std::complex<float> * out;
+    fftwf_plan plan;
+};
+
+#endif //SPEECH_ANALYSIS_STFT_H
@@ -0,0 +1,77 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "SlidingDFT.h"
+#include "FFT.h"
+
+using namespace Eigen;
+
+SlidingDFT::SlidingDFT(int n, int m, int refreshSamples)
+    : n(n),
+      m(std::clamp(m, 1, n / 2 + 1)),
+      refreshSamples(refreshSamples),
+      sinceRefresh(0),
+      valid(false),
+      bins(this->m + 1),
+      twiddles(this->m + 1),
+      history(n),
+      head(0)
+{
+    for (int k = 0; k <= this->m; ++k) {
+        twiddles(k) = std::polar(1.0, 2 * M_PI * k / n);
+    }
+}
+
+void SlidingDFT::update(const Ref<const ArrayXf> & window, int advance)
+{
+    if (!valid || advance <= 0 || advance >= n || sinceRefresh + advance > refreshSamples) {
+        recompute(window);
+        return;
+    }
+
+    // X(k) <- (X(k) + x(t) - x(t - n)) exp(j 2 pi k / n)
+    for (int i = n - advance; i < n; ++i) {
+        const double x = window(i);
+
+        bins += x - history(head);
+        bins *= twiddles;
+
+        history(head) = x;
+        head = (head + 1) % n;
+    }
+
+    sinceRefresh += advance;
+}
+
+void SlidingDFT::recompute(const Ref<const ArrayXf> & window)
+{
+    auto & plan = fft_cached_plan<RCFFT>(n);
+
+    history = window.head(n).cast<double>();
+    head = 0;
+
+    plan.input() = history;
+    plan.execute();
+
+    // Above n / 2, the bins mirror the ones below.
+    for (int k = 0; k <= m; ++k) {
+        bins(k) = k <= n / 2 ? plan.out()[k] : std::conj(plan.out()[n - k]);
+    }
+
+    sinceRefresh = 0;
+    valid = true;
+}
+
+void SlidingDFT::power(ArrayXd & out) const
+{
+    out.resize(m);
+
+    // Hann: 0.5 X(k) - 0.25 (X(k - 1) + X(k + 1)), with X(-1) = conj(X(1)).
+    for (int k = 0; k < m; ++k) {
+        const std::complex<double> below = k > 0 ? bins(k - 1) : std::conj(bins(1));
+        out(k) = std::norm(0.5 * bins(k) - 0.25 * (below + bins(k + 1)));
+    }
+}
@@ -0,0 +1,63 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_SLIDINGDFT_H
+#define SPEECH_ANALYSIS_SLIDINGDFT_H
+
+#include <Eigen/Core>
+
+// Sliding DFT of the last n samples of a stream, over the bins 0 to m - 1
+// only. Each new sample updates every bin in O(1), so a hop of h samples
+// costs O(h m) instead of a full FFT. The bins are recomputed with an FFT
+// after refreshSamples samples, to bound the drift of the recurrence, and
+// whenever the stream is not contiguous.
+//
+// The Hann window is applied in the frequency domain, as a three-tap kernel
+// on neighbouring bins. That window is periodic (period n). It is not the
+// symmetric Window::createHanning(n) (period n - 1) that the FFT spectrum
+// uses, so the two paths differ slightly in leakage and level.
+//
+// Only the new samples of each window are added to the bins. Samples that
+// are already in the bins are not taken again from later windows. A filter
+// that the caller applies to each window separately, such as the
+// engine's per-frame pre-emphasis, therefore reaches the bins as it was
+// applied when each sample was new. For the pre-emphasis this affects
+// only the first sample of a window, which has no previous sample. An FFT
+// of the window leaves that sample unfiltered. Between recomputes, the
+// sliding bins hold it filtered against the sample before the window.
+
+class SlidingDFT {
+public:
+    SlidingDFT(int n, int m, int refreshSamples);
+
+    [[nodiscard]] int size() const noexcept { return n; }
+    [[nodiscard]] int binCount() const noexcept { return m; }
+
+    // `window` holds the last n samples of the stream, which moved on by
+    // `advance` samples since the previous call. With advance <= 0 or
+    // beyond the window, the bins are recomputed from the window.
+    void update(const Eigen::Ref<const Eigen::ArrayXf> & window, int advance);
+
+    // Hann-windowed power |X(k)|^2 of the first m bins.
+    void power(Eigen::ArrayXd & out) const;
+
+private:
+    void recompute(const Eigen::Ref<const Eigen::ArrayXf> & window);
+
+    int n;
+    int m;
+    int refreshSamples;
+    int sinceRefresh;
+    bool valid;
+
+    // Bins 0 to m, since the window needs one neighbour above the last.
+    Eigen::ArrayXcd bins;
+    Eigen::ArrayXcd twiddles;
+
+    // The samples in the window, as added to the bins, from position head.
+    Eigen::ArrayXd history;
+    int head;
+};
+
+#endif //SPEECH_ANALYSIS_SLIDINGDFT_H
@@ -23,13 +23,22 @@ namespace LPC {
     void filterInverse(const Frame & lpc, Eigen::ArrayXd & x);
 
     int frame_auto(const Eigen::ArrayXd & sound, Frame & lpc);
+    // Same as frame_auto, from at least lpc.nCoefficients + 1 autocorrelation lags.
+    int frame_auto_acorr(const Eigen::ArrayXd & acorr, Frame & lpc);
     bool frame_covar(const Eigen::ArrayXd & sound, Frame & lpc);
     bool frame_burg(const Eigen::ArrayXd & sound, Frame & lpc);
+    // Single precision samples; the coefficients are still computed in double.
+    bool frame_burg(const Eigen::ArrayXf & sound, Frame & lpc);
 
     void frame_huber(const Eigen::ArrayXd & sound, const Frame & lpc1, Frame & lpc2, Huber::huber_s & hs);
 
     void toFormantFrame(const Frame & lpc, Formant::Frame & frm, double samplingFrequency);
 
+    // |1 / A(e^jw)| at each of `frequencies`, in Hz for a sampling rate of
+    // samplingFrequency, with A(z) = 1 + sum_k a(k) z^-(k+1). The grid may be
+    // spaced in any way; out must have the same size.
+    void envelope(const Frame & lpc, const Eigen::ArrayXd & frequencies, double samplingFrequency, Eigen::Ref<Eigen::ArrayXd> out);
+
 }
 
 #endif //SPEECH_ANALYSIS_LPC_FRAME_H
@@ -12,6 +12,19 @@ int LPC::frame_auto(const ArrayXd & x, LPC::Frame & lpc) {
 
     const int n = x.size();
     const int m = lpc.nCoefficients;
+
+    ArrayXd acorr = ArrayXd::Zero(m + 1);
+
+    for (int k = 0; k <= m && k < n; ++k) {
+        acorr(k) = x.head(n - k).matrix().dot(x.tail(n - k).matrix());
+    }
+
+    return frame_auto_acorr(acorr, lpc);
+}
+
+int LPC::frame_auto_acorr(const ArrayXd & acorr, LPC::Frame & lpc) {
+
+    const int m = lpc.nCoefficients;
     int i = 1;
 
     lpc.a.setZero(m);
@@ -20,11 +33,7 @@ int LPC::frame_auto(const ArrayXd & x, LPC::Frame & lpc) {
     ArrayXd a = ArrayXd::Zero(m + 2);
     ArrayXd rc = ArrayXd::Zero(m + 1);
 
-    for (i = 1; i <= m + 1; ++i) {
-        for (int j = 1; j <= n - i + 1; ++j) {
-            r(i) += x(j - 1) * x(j + i - 2);
-        }
-    }
+    r.tail(m + 1) = acorr.head(m + 1);
 
     if (r(1) == 0.0) {
         i = 1;
@@ -8,34 +8,20 @@
 
 using namespace Eigen;
 
-static double vecBurg(ArrayXd & a, const ArrayXd & x);
-
-bool LPC::frame_burg(const ArrayXd & x, LPC::Frame & lpc) {
-
-    lpc.a.resize(lpc.nCoefficients);
-
-    lpc.gain = vecBurg(lpc.a, x);
-    lpc.gain *= x.size();
-    for (int i = 0; i < lpc.nCoefficients; ++i) {
-        lpc.a(i) = -lpc.a(i);
-    }
-
-    return lpc.gain != 0.0;
-
-}
-
-double vecBurg(ArrayXd & a, const ArrayXd & x)
+// The sample buffers and their inner products are in the precision of x.
+template<typename Real>
+static double vecBurg(ArrayXd & a, const Array<Real, Dynamic, 1> & x)
 {
+    using ArrayXr = Array<Real, Dynamic, 1>;
+
     int n = x.size(), m = a.size();
     a.setZero();
 
-    ArrayXd b1 = ArrayXd::Zero(n + 1);
-    ArrayXd b2 = ArrayXd::Zero(n + 1);
+    ArrayXr b1 = ArrayXr::Zero(n + 1);
+    ArrayXr b2 = ArrayXr::Zero(n + 1);
     ArrayXd aa = ArrayXd::Zero(m + 1);
 
-    double p = 0.0;
-    for (int j = 0; j < n; ++j)
-        p += x(j) * x(j);
+    double p = x.matrix().squaredNorm();
 
     double xms = p / static_cast<double>(n);
     if (xms <= 0.0)
@@ -47,11 +33,11 @@ double vecBurg(ArrayXd & a, const ArrayXd & x)
         b1(j) = b2(j - 1) = x(j - 1);
 
     for (int i = 1; i <= m; ++i) {
-        double num = 0.0, denom = 0.0;
-        for (int j = 1; j <= n - i; ++j) {
-            num += b1(j) * b2(j);
-            denom += b1(j) * b1(j) + b2(j) * b2(j);
-        }
+        const auto v1 = b1.segment(1, n - i).matrix();
+        const auto v2 = b2.segment(1, n - i).matrix();
+
+        const double num = v1.dot(v2);
+        const double denom = v1.squaredNorm() + v2.squaredNorm();
 
         if (denom <= 0.0)
             return 0.0;
@@ -66,12 +52,35 @@ double vecBurg(ArrayXd & a, const ArrayXd & x)
         if (i < m) {
             for (int j = 1; j <= i; ++j)
                 aa(j) = a(j - 1);
+            const Real k = aa(i);
             for (int j = 1; j <= n - i - 1; ++j) {
-                b1(j) -= aa(i) * b2(j);
-                b2(j) = b2(j + 1) - aa(i) * b1(j + 1);
+                b1(j) -= k * b2(j);
+                b2(j) = b2(j + 1) - k * b1(j + 1);
             }
         }
     }
 
     return xms;
 }
+
+template<typename Real>
+static bool burg(const Array<Real, Dynamic, 1> & x, LPC::Frame & lpc)
+{
+    lpc.a.resize(lpc.nCoefficients);
+
+    lpc.gain = vecBurg(lpc.a, x);
+    lpc.gain *= x.size();
+    for (int i = 0; i < lpc.nCoefficients; ++i) {
+        lpc.a(i) = -lpc.a(i);
+    }
+
+    return lpc.gain != 0.0;
+}
+
+bool LPC::frame_burg(const ArrayXd & x, LPC::Frame & lpc) {
+    return burg(x, lpc);
+}
+
+bool LPC::frame_burg(const ArrayXf & x, LPC::Frame & lpc) {
+    return burg(x, lpc);
+}
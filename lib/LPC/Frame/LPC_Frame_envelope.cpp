@@ -0,0 +1,34 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <cmath>
+#include "../LPC.h"
+#include "LPC_Frame.h"
+
+using namespace Eigen;
+
+void LPC::envelope(const LPC::Frame & lpc, const ArrayXd & frequencies, double samplingFrequency, Ref<ArrayXd> out)
+{
+    const int p = lpc.nCoefficients;
+
+    for (int i = 0; i < frequencies.size(); ++i) {
+        const double w = 2 * M_PI * frequencies(i) / samplingFrequency;
+        const double c = std::cos(w);
+        const double s = std::sin(w);
+
+        // Clenshaw's recurrence on z^-k = 2 cos(w) z^-(k-1) - z^-(k-2), so
+        // that the twiddles are never formed: A = 1 - b2 + b1 e^-jw.
+        double b1 = 0, b2 = 0;
+        for (int k = p; k >= 1; --k) {
+            const double b = lpc.a(k - 1) + 2 * c * b1 - b2;
+            b2 = b1;
+            b1 = b;
+        }
+
+        const double re = 1 - b2 + b1 * c;
+        const double im = -b1 * s;
+
+        out(i) = 1.0 / std::sqrt(re * re + im * im);
+    }
+}
@@ -0,0 +1,69 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_DYNAMICWAVELET_H
+#define SPEECH_ANALYSIS_DYNAMICWAVELET_H
+
+#include <Eigen/Core>
+#include <vector>
+#include "Estimator.h"
+
+namespace Pitch {
+
+    // Dynamic wavelet pitch tracker (Larson & Maddox, 2005).
+    //
+    // The frame goes through up to maxLevels levels of the Haar lifting
+    // transform, computed in place in one buffer, and the period is the mode
+    // of the distances between extrema where two levels agree. The last
+    // pitch is kept to settle ties between candidate modes at the next frame.
+    //
+    // F0max sets the shortest distance between extrema, and F0min is unused.
+    // The candidates are the modes found at each level, with the fraction of
+    // the distances that agree with them as confidence.
+    //
+    // Buffers are allocated for the configured frame length, and again only
+    // if a frame of another length comes in.
+
+    class DynamicWavelet : public Estimator {
+    public:
+        DynamicWavelet(const Config & config, int maxLevels, int differenceLevels, double maximaThresholdRatio);
+
+        void estimate(const Eigen::ArrayXd & x, Estimation & result) override;
+
+        void reset() override;
+
+        // Sets the pitch that the next frame is expected near, 0 for none.
+        void setLastPitch(double lastPitch);
+
+        [[nodiscard]] double getLastPitch() const noexcept { return lastPitch; }
+
+    private:
+        void allocate(int frameLength);
+        bool estimateLevels(double fs, Estimation & result);
+        int findMode(int level, int width, int minDist, double oldMode);
+
+        int maxLevels;
+        double maxF;
+        int differenceLevels;
+        double maximaThresholdRatio;
+
+        double lastPitch;
+
+        // Approximation at the current level, in place over the previous one.
+        Eigen::ArrayXd a;
+        int dataLen;
+
+        std::vector<int> maxCount, minCount, mode;
+        // Fraction of the distances within minDist of the mode.
+        std::vector<double> agreement;
+        Eigen::ArrayXi maxIndices, minIndices;
+        Eigen::ArrayXi differs;
+        int differCount;
+        // Number of differences below each distance.
+        Eigen::ArrayXi cumulative;
+    };
+
+}
+
+#endif //SPEECH_ANALYSIS_DYNAMICWAVELET_H
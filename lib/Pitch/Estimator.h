@@ -0,0 +1,129 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_PITCH_ESTIMATOR_H
+#define SPEECH_ANALYSIS_PITCH_ESTIMATOR_H
+
+#include <Eigen/Core>
+#include <vector>
+#include "Pitch.h"
+#include "../FFT/FFT.h"
+
+namespace Pitch {
+
+    // Pitch estimator for frames of a fixed length at a fixed sample rate.
+    //
+    // Constants, FFT plans and scratch buffers are set up at construction,
+    // so that estimate() does not allocate. Besides the pitch, it leaves a
+    // confidence between 0 and 1 and a list of the candidates it weighed,
+    // which stay valid until the next call.
+
+    class Estimator {
+    public:
+        struct Config {
+            double sampleRate;
+            int frameLength;
+            double F0min;
+            double F0max;
+        };
+
+        struct Candidate {
+            double pitch;
+            double confidence;
+        };
+
+        static constexpr int MAX_CANDIDATES = 8;
+
+        explicit Estimator(const Config & config);
+        virtual ~Estimator() = default;
+
+        Estimator(const Estimator &) = delete;
+        Estimator & operator=(const Estimator &) = delete;
+
+        // x holds config().frameLength samples.
+        virtual void estimate(const Eigen::ArrayXd & x, Estimation & result) = 0;
+
+        // Forgets the state carried from previous frames, if any.
+        virtual void reset() {}
+
+        [[nodiscard]] const Config & config() const noexcept { return cfg; }
+        [[nodiscard]] double confidence() const noexcept { return lastConfidence; }
+        [[nodiscard]] const std::vector<Candidate> & candidates() const noexcept { return candidateList; }
+
+    protected:
+        // Clears the confidence and the candidates of the previous frame.
+        void beginFrame();
+        // Ignored past MAX_CANDIDATES.
+        void addCandidate(double pitch, double confidence);
+        void setConfidence(double confidence);
+
+        const Config cfg;
+
+    private:
+        double lastConfidence;
+        std::vector<Candidate> candidateList;
+    };
+
+    // The key maxima of the normalised autocorrelation are the candidates,
+    // with their height as confidence.
+    class McLeodEstimator : public Estimator {
+    public:
+        explicit McLeodEstimator(const Config & config);
+
+        void estimate(const Eigen::ArrayXd & x, Estimation & result) override;
+
+    private:
+        RCFFTPlan forward;
+        CRFFTPlan backward;
+        Eigen::ArrayXd nsdf;
+        std::vector<int> maxPositions;
+        // Interpolated lag and height of each key maximum.
+        std::vector<std::pair<double, double>> estimates;
+    };
+
+    // Only the lags up to the period of F0min are normalised. The confidence
+    // is one minus the normalised difference at the dip.
+    class YinEstimator : public Estimator {
+    public:
+        YinEstimator(const Config & config, double threshold);
+
+        void estimate(const Eigen::ArrayXd & x, Estimation & result) override;
+
+    private:
+        double threshold;
+        RCFFTPlan forward;
+        CRFFTPlan backward;
+        Eigen::ArrayXd d;
+    };
+
+    // Time-domain YIN, as in estimate_YIN with F0min. It needs no buffers.
+    class FastYinEstimator : public Estimator {
+    public:
+        FastYinEstimator(const Config & config, double threshold);
+
+        void estimate(const Eigen::ArrayXd & x, Estimation & result) override;
+
+    private:
+        double threshold;
+        int maxLag;
+    };
+
+    // As estimate_AMDF. The confidence is one minus the depth of the dip
+    // relative to the highest magnitude difference.
+    class AmdfEstimator : public Estimator {
+    public:
+        AmdfEstimator(const Config & config, double ratio, double sensitivity, int decimation = 1);
+
+        void estimate(const Eigen::ArrayXd & x, Estimation & result) override;
+
+    private:
+        double ratio;
+        double sensitivity;
+        int decimation;
+        Eigen::ArrayXd amd, xd;
+    };
+
+}
+
+#endif //SPEECH_ANALYSIS_PITCH_ESTIMATOR_H
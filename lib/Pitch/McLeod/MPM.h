@@ -13,10 +13,11 @@ using Eigen::ArrayXd, Eigen::Ref;
 
 namespace MPM {
 
-    ArrayXd autocorrelation(Ref<const ArrayXd> x);
-
     std::vector<int> peakPicking(Ref<const ArrayXd> x);
 
+    // Fills maxPositions, which keeps its capacity from one call to the next.
+    void peakPicking(Ref<const ArrayXd> x, std::vector<int> & maxPositions);
+
     std::pair<double, double> parabolicInterpolation(Ref<const ArrayXd> array, int x);
 
 }
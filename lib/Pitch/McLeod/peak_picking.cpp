@@ -6,6 +6,12 @@
 
 std::vector<int> MPM::peakPicking(Ref<const ArrayXd> x) {
     std::vector<int> maxPositions;
+    peakPicking(x, maxPositions);
+    return maxPositions;
+}
+
+void MPM::peakPicking(Ref<const ArrayXd> x, std::vector<int> & maxPositions) {
+    maxPositions.clear();
 
     int pos = 0;
     int currentMaxPos = 0;
@@ -38,6 +44,4 @@ std::vector<int> MPM::peakPicking(Ref<const ArrayXd> x) {
     if (currentMaxPos > 0) {
         maxPositions.push_back(currentMaxPos);
     }
-
-    return maxPositions;
 }
\ No newline at end of file
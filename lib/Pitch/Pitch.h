@@ -14,14 +14,27 @@ namespace Pitch {
         bool isVoiced;
     };
 
-    void estimate_AMDF(const Eigen::ArrayXd & x, double fs, Pitch::Estimation & result, double F0min, double F0max, double ratio, double sensitivity);
+    // Only the lags between the periods of F0max and F0min are computed.
+    // With decimation > 1, they are first searched on the signal box-filtered
+    // and decimated by that factor, and the period is then refined at the
+    // full rate.
+    void estimate_AMDF(const Eigen::ArrayXd & x, double fs, Pitch::Estimation & result, double F0min, double F0max, double ratio, double sensitivity, int decimation = 1);
    
     void estimate_MPM(const Eigen::ArrayXd & x, double fs, Pitch::Estimation & result);
+    // Same as estimate_MPM, from the autocorrelation of the frame as given by
+    // Autocorrelation::compute.
+    void estimate_MPM_acorr(const Eigen::ArrayXd & acorr, double fs, Pitch::Estimation & result);
 
     void estimate_DynWav(const Eigen::ArrayXd & x, double fs, Pitch::Estimation & result, int maxLevels, double maxF, int differenceLevels, double maximaThresholdRatio, double oldFreq);
 
+    // Correlates over a window of half the frame.
     void estimate_YIN(const Eigen::ArrayXd & x, double fs, Pitch::Estimation & result, double threshold);
 
+    // Time-domain YIN that stops at the first dip below threshold, without
+    // any FFT. It is cheaper for high voices, and never looks for periods
+    // longer than 1 / F0min.
+    void estimate_YIN(const Eigen::ArrayXd & x, double fs, Pitch::Estimation & result, double threshold, double F0min);
+
 }
 
 #endif //SPEECH_ANALYSIS_PITCH_H
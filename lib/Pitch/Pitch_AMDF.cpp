@@ -2,62 +2,181 @@
 // Created by clo on 13/09/2019.
 //
 
+#include <algorithm>
+#include <cmath>
 #include "Pitch.h"
+#include "Estimator.h"
 
 using namespace Eigen;
 
-void Pitch::estimate_AMDF(const ArrayXd & x, double fs, Pitch::Estimation & result, double F0min, double F0max, double ratio, double sensitivity) {
+// Magnitude difference sums at the lags minLag .. minLag + amd.size() - 1.
+static void magnitudeDifference(const Ref<const ArrayXd> & x, int minLag, Ref<ArrayXd> amd)
+{
+    const int n = x.size();
 
-    const int maxShift = x.size();
+    for (int k = 0; k < amd.size(); ++k) {
+        const int lag = minLag + k;
+        amd(k) = (x.head(n - lag) - x.segment(lag, n - lag)).abs().sum();
+    }
+}
+
+// Index of the first dip under the cutoff, moved to the lowest point within
+// searchLength after it, or -1 if there is none.
+static int findDip(const Ref<const ArrayXd> & amd, double cutoff, int searchLength)
+{
+    const int n = amd.size();
+
+    int j = 0;
+    while (j < n && amd(j) > cutoff) {
+        j++;
+    }
+
+    if (j == n) {
+        return -1;
+    }
+
+    int minPos = j;
+
+    for (int i = j + 1; i <= std::min(j + searchLength, n - 1); ++i) {
+        if (amd(i) < amd(minPos)) {
+            minPos = i;
+        }
+    }
 
-    const int maxPeriod = ceil(fs / F0min);
-    const int minPeriod = floor(fs / F0max);
+    return minPos;
+}
+
+// Lags between the periods of F0max and F0min, at the full rate and at the
+// decimated rate, so that the buffers can be sized once.
+static int lagCount(int n, double fs, double F0min, double F0max, int decimation, int & minPeriod)
+{
+    const int maxPeriod = std::min<int>(ceil(fs / F0min) / decimation, n / decimation - 1);
+    minPeriod = floor(fs / F0max) / decimation;
+    return maxPeriod - minPeriod + 1;
+}
 
-    ArrayXd amd = ArrayXd::Zero(maxShift);
+// Returns the period at the full rate, or -1 if there is none. The buffers
+// are only resized if too short.
+static int findPeriod(const ArrayXd & x, double fs, double F0min, double F0max, double ratio, double sensitivity, int decimation,
+                      ArrayXd & amd, ArrayXd & xd, double & depth)
+{
+    const int n = x.size() / decimation;
 
-    for (int i = 0; i < maxShift; ++i) {
+    int minPeriod;
+    const int count = lagCount(x.size(), fs, F0min, F0max, decimation, minPeriod);
 
-        const auto frame1 = x.segment(0, maxShift - i);
-        const auto frame2 = x.segment(i, maxShift - i);
+    if (minPeriod < 1 || count < 2) {
+        return -1;
+    }
+
+    // Box-filtered and decimated. The box sums are deliberately not divided
+    // by decimation: each is about decimation times a full-rate sample and
+    // there are decimation times fewer of them, so the magnitude difference
+    // sums stay at the full-rate scale. The thresholds are ratios of min and
+    // max, but they are rounded, so that scale matters.
+    if (decimation > 1) {
+        if (xd.size() < n) {
+            xd.resize(n);
+        }
+        auto head = xd.head(n);
+        head = Map<const ArrayXd, 0, InnerStride<>>(x.data(), n, InnerStride<>(decimation));
+        for (int k = 1; k < decimation; ++k) {
+            head += Map<const ArrayXd, 0, InnerStride<>>(x.data() + k, n, InnerStride<>(decimation));
+        }
+    }
+    const Ref<const ArrayXd> signal = decimation > 1 ? Ref<const ArrayXd>(xd.head(n)) : Ref<const ArrayXd>(x);
 
-        amd(i) = (frame1 - frame2).abs().sum();
+    // Enough for the refinement too, which needs at most 2 * decimation + 1.
+    const int bufferSize = std::max(count, 2 * decimation + 1);
+    if (amd.size() < bufferSize) {
+        amd.resize(bufferSize);
     }
 
-    const auto validAmd = amd.segment(minPeriod, maxPeriod - minPeriod);
+    auto coarse = amd.head(count);
+    magnitudeDifference(signal, minPeriod, coarse);
 
-    double minVal = validAmd.minCoeff();
-    double maxVal = validAmd.maxCoeff();
+    const double minVal = coarse.minCoeff();
+    const double maxVal = coarse.maxCoeff();
 
     const double cutoff = round((sensitivity * (maxVal - minVal)) + minVal);
 
-    int j = minPeriod;
-    while (j <= maxPeriod && amd(j) > cutoff) {
-        j++;
+    const int dip = findDip(coarse, cutoff, minPeriod / 2);
+
+    if (dip < 0 || round(coarse(dip) * ratio) >= maxVal) {
+        return -1;
     }
 
-    const int searchLength = minPeriod / 2;
+    depth = 1 - coarse(dip) / maxVal;
 
-    int minPos = j;
-    minVal = amd(j);
+    int period = minPeriod + dip;
 
-    int i = j;
-    while (i < j + searchLength && i <= maxPeriod) {
-        i++;
+    // Refine around the coarse period at the full rate.
+    if (decimation > 1) {
+        const int lo = std::max<int>(decimation * (period - 1), 1);
+        const int hi = std::min<int>(decimation * (period + 1), x.size() - 1);
 
-        double cur = amd(j);
-        if (cur < minVal) {
-            minPos = i;
-            minVal = cur;
-        }
+        auto fine = amd.head(hi - lo + 1);
+        magnitudeDifference(x, lo, fine);
+
+        Index best;
+        fine.minCoeff(&best);
+        period = lo + best;
     }
 
-    result.isVoiced = (round(minVal * ratio) < maxVal);
+    return period;
+}
+
+void Pitch::estimate_AMDF(const ArrayXd & x, double fs, Pitch::Estimation & result, double F0min, double F0max, double ratio, double sensitivity, int decimation) {
+
+    // Reused from one frame to the next by each thread.
+    static thread_local ArrayXd amd, xd;
 
-    if (result.isVoiced) {
-        result.pitch = fs / static_cast<double>(minPos);
+    double depth;
+    const int period = findPeriod(x, fs, F0min, F0max, ratio, sensitivity, std::max(decimation, 1), amd, xd, depth);
+
+    if (period > 0) {
+        result.isVoiced = true;
+        result.pitch = fs / static_cast<double>(period);
     }
     else {
+        result.isVoiced = false;
         result.pitch = NAN;
     }
+}
+
+Pitch::AmdfEstimator::AmdfEstimator(const Config & config, double _ratio, double _sensitivity, int _decimation)
+    : Estimator(config),
+      ratio(_ratio),
+      sensitivity(_sensitivity),
+      decimation(std::max(_decimation, 1))
+{
+    int minPeriod;
+    const int count = lagCount(config.frameLength, config.sampleRate, config.F0min, config.F0max, decimation, minPeriod);
+
+    amd.resize(std::max({count, 2 * decimation + 1, 1}));
+    if (decimation > 1) {
+        xd.resize(config.frameLength / decimation);
+    }
+}
+
+void Pitch::AmdfEstimator::estimate(const ArrayXd & x, Pitch::Estimation & result)
+{
+    const double fs = cfg.sampleRate;
+
+    beginFrame();
+
+    double depth;
+    const int period = findPeriod(x, fs, cfg.F0min, cfg.F0max, ratio, sensitivity, decimation, amd, xd, depth);
 
+    if (period > 0) {
+        addCandidate(fs / period, depth);
+        setConfidence(depth);
+
+        result.isVoiced = true;
+        result.pitch = fs / static_cast<double>(period);
+    }
+    else {
+        result.isVoiced = false;
+        result.pitch = NAN;
+    }
 }
@@ -2,90 +2,146 @@
 // Created by clo on 13/12/2019.
 //
 
-#include <cfloat>
-#include <iostream>
-#include <vector>
-#include <map>
+#include <algorithm>
+#include <cmath>
 #include "Pitch.h"
+#include "DynamicWavelet.h"
 
 using namespace Eigen;
 
-void Pitch::estimate_DynWav(const ArrayXd & _x, double fs, Pitch::Estimation & result,
+void Pitch::estimate_DynWav(const ArrayXd & x, double fs, Pitch::Estimation & result,
                             int lev, double maxFreq, int diffLevs, double globalMaxThresh, double oldFreq)
+{
+    DynamicWavelet tracker({fs, static_cast<int>(x.size()), 0, maxFreq}, lev, diffLevs, globalMaxThresh);
+    tracker.setLastPitch(oldFreq);
+    tracker.estimate(x, result);
+}
+
+Pitch::DynamicWavelet::DynamicWavelet(const Config & config, int maxLevels, int differenceLevels, double maximaThresholdRatio)
+    : Estimator(config),
+      maxLevels(maxLevels),
+      maxF(config.F0max),
+      differenceLevels(differenceLevels),
+      maximaThresholdRatio(maximaThresholdRatio),
+      lastPitch(0),
+      dataLen(0),
+      maxCount(maxLevels, 0),
+      minCount(maxLevels, 0),
+      mode(maxLevels, 0),
+      agreement(maxLevels, 0.0),
+      differCount(0)
+{
+    allocate(config.frameLength);
+}
+
+void Pitch::DynamicWavelet::reset()
+{
+    lastPitch = 0;
+}
+
+void Pitch::DynamicWavelet::setLastPitch(double _lastPitch)
+{
+    lastPitch = std::max(_lastPitch, 0.0);
+}
+
+void Pitch::DynamicWavelet::allocate(int frameLength)
 {
     // Resize to a multiple of 64.
-    int dataLen = (_x.size() / 64) * 64;
+    const int newLen = (frameLength / 64) * 64;
+
+    if (newLen != dataLen) {
+        dataLen = newLen;
+        a.resize(dataLen);
+        maxIndices.resize(dataLen / 2);
+        minIndices.resize(dataLen / 2);
+        differs.resize(differenceLevels * (dataLen / 2));
+        cumulative.resize(dataLen / 2 + 1);
+    }
+}
+
+void Pitch::DynamicWavelet::estimate(const ArrayXd & x, Pitch::Estimation & result)
+{
+    const double fs = cfg.sampleRate;
+
+    beginFrame();
+    allocate(x.size());
+
+    if (dataLen == 0) {
+        result.isVoiced = false;
+        lastPitch = 0;
+        return;
+    }
+
+    a = x.head(dataLen);
+
+    result.isVoiced = estimateLevels(fs, result);
+    lastPitch = result.isVoiced ? result.pitch : 0;
+}
+
+bool Pitch::DynamicWavelet::estimateLevels(double fs, Pitch::Estimation & result)
+{
+    const int lev = maxLevels;
 
     // Set old mode if old freq is set.
-    double oldMode = oldFreq > 0 ? fs / oldFreq : 0;
-    
-    std::vector<int> maxCount(lev, 0);
-    std::vector<int> minCount(lev, 0);
-    std::vector<int> mode(lev, 0);
-    
-    std::vector<int> maxIndices;
-    std::vector<int> minIndices;
-
-    std::vector<ArrayXd> a(lev);
-    a[0] = _x.head(dataLen);
-
-    double aver = a[0].mean();
-    double globalMax = a[0].maxCoeff();
-    double globalMin = a[0].minCoeff();
-    double maxThresh = globalMaxThresh * (globalMax - aver) + aver; // Adjust for DC offset
-    double minThresh = globalMaxThresh * (globalMin - aver) + aver;
+    const double oldMode = lastPitch > 0 ? fs / lastPitch : 0;
+
+    std::fill(maxCount.begin(), maxCount.end(), 0);
+    std::fill(minCount.begin(), minCount.end(), 0);
+    std::fill(mode.begin(), mode.end(), 0);
+    std::fill(agreement.begin(), agreement.end(), 0.0);
+
+    const double aver = a.mean();
+    const double globalMax = a.maxCoeff();
+    const double globalMin = a.minCoeff();
+    const double maxThresh = maximaThresholdRatio * (globalMax - aver) + aver; // Adjust for DC offset
+    const double minThresh = maximaThresholdRatio * (globalMin - aver) + aver;
 
     // Begin pitch detection
-    
+
     for (int i = 1; i < lev; ++i) {
-        int newWidth = dataLen / (2 << (i - 1));
+        const int newWidth = dataLen / (2 << (i - 1));
+
+        if (newWidth < 2) {
+            break;
+        }
+
+        // Perform the FLWT in place: a(j) only overwrites samples already read.
 
-        // Perform the FLWT.
-        
-        ArrayXd d(newWidth);
-        ArrayXd acur(newWidth);
         for (int j = 0; j < newWidth; ++j) {
-            d(j) = a[i - 1](2 * j + 1) - a[i - 1](2 * j);
-            acur(j) = a[i - 1](2 * j) + d(j) / 2;
+            const double d = a(2 * j + 1) - a(2 * j);
+            a(j) = a(2 * j) + d / 2;
         }
-        a[i] = std::move(acur);
 
         // Find the maxes of the current approximation
 
-        int minDist = std::max<int>(floor(fs / maxFreq / (2 << (i - 1))), 1);
-        maxCount[i] = 0;
-        minCount[i] = 0;
-        maxIndices.clear();
-        minIndices.clear();
+        const int minDist = std::max<int>(floor(fs / maxF / (2 << (i - 1))), 1);
 
-        int climber = (a[i](1) - a[i](0) > 0) ? 1 : -1;
+        int climber = (a(1) - a(0) > 0) ? 1 : -1;
 
         bool canExt = true; // Tracks whether an extreme can be found (based on zero-crossings)
         int tooClose = 0;   // Tracks how many more samples must be moved before another extreme
 
         for (int j = 1; j < newWidth - 1; ++j) {
-            double test = a[i](j) - a[i](j - 1);
+            const double test = a(j) - a(j - 1);
 
             if (climber >= 0 && test < 0) {
-                if (a[i](j - 1) >= maxThresh && canExt && tooClose == 0) {
-                    maxCount[i]++;
-                    maxIndices.push_back(j - 1);
+                if (a(j - 1) >= maxThresh && canExt && tooClose == 0) {
+                    maxIndices(maxCount[i]++) = j - 1;
                     canExt = false;
                     tooClose = minDist;
                 }
                 climber = -1;
             }
             else if (climber <= 0 && test > 0) {
-                if (a[i](j - 1) <= minThresh && canExt && tooClose == 0) {
-                    minCount[i]++;
-                    minIndices.push_back(j - 1);
+                if (a(j - 1) <= minThresh && canExt && tooClose == 0) {
+                    minIndices(minCount[i]++) = j - 1;
                     canExt = false;
                     tooClose = minDist;
                 }
                 climber = 1;
             }
 
-            if ((a[i](j) <= aver && a[i](j - 1) > aver) || (a[i](j) >= aver && a[i](j - 1) < aver)) {
+            if ((a(j) <= aver && a(j - 1) > aver) || (a(j) >= aver && a(j - 1) < aver)) {
                 canExt = true;
             }
 
@@ -95,84 +151,106 @@ void Pitch::estimate_DynWav(const ArrayXd & _x, double fs, Pitch::Estimation & r
         }
 
         // Calculate the mode distance between peaks at each level
-        
+
         if (maxCount[i] >= 2 && minCount[i] >= 2) {
 
-            // Calculate the differences at diffLevs distances
-            
-            std::vector<int> differs;
-            for (int j = 1; j <= diffLevs; ++j) { // Interval of differences (neighbor, next-neighbor)
+            // Calculate the differences at differenceLevels distances
+
+            differCount = 0;
+            for (int j = 1; j <= differenceLevels; ++j) { // Interval of differences (neighbor, next-neighbor)
                 for (int k = 0; k < maxCount[i] - j; ++k) { // Starting point of each run
-                    differs.push_back(maxIndices[k + j] - maxIndices[k]);
+                    differs(differCount++) = maxIndices(k + j) - maxIndices(k);
                 }
                 for (int k = 0; k < minCount[i] - j; ++k) { // Starting point of each run
-                    differs.push_back(minIndices[k + j] - minIndices[k]);
+                    differs(differCount++) = minIndices(k + j) - minIndices(k);
                 }
             }
-            
-            int dCount = differs.size();
-
-            // Find the center mode of the differences
 
-            int numer = 1; // Require at least two agreeing differs to yield a mode
-            mode[i] = 0;   // If none is found, leave as zero
+            mode[i] = findMode(i, newWidth, minDist, oldMode);
 
-            for (int j = 0; j < dCount; ++j) {
-                
-                // Find the # of times that distance j is within minDist samples of another distance
-                int numerJ = 0;
-                for (int k = 0; k < dCount; ++k) {
-                    if (std::abs(differs[k] - differs[j]) <= minDist)
-                        numerJ++;
-                }
-
-                // If there are more, set the new standard
-                if (numerJ >= numer && numerJ > floor(newWidth / differs[j]) / 4) {
-                    if (numerJ == numer) {
-                        if (oldMode != 0 && std::abs(differs[j] - oldMode / (2 << (i - 1))) < minDist) {
-                            mode[i] = differs[j];
-                        }
-                        else if (oldMode == 0 && (differs[j] > 1.95 * mode[i] && differs[j] < 2.05 * mode[i])) {
-                            mode[i] = differs[i];
-                        }
-                    }
-                    else {
-                        numer = numerJ;
-                        mode[i] = differs[j];
-                    }
-                }
-                else if (numerJ == numer - 1 && oldMode != 0 && std::abs(differs[j] - oldMode / (2 << (i - 1))) < minDist) {
-                    mode[i] = differs[j];
-                }
-            }
-
-            // Set the mode via averaging.
-            
             if (mode[i] != 0) {
-                double mean = 0;
-                double meanCount = 0;
-                for (int k = 0; k < dCount; ++k) {
-                    if (std::abs(mode[i] - differs[k]) <= minDist) {
-                        mean += differs[k];
-                        meanCount++;
-                    }
-                }
-                mode[i] = mean / meanCount;
+                addCandidate(fs / mode[i] / (2 << (i - 1)), agreement[i]);
             }
 
             // Determine if the modes are shared
-            
+
             if (mode[i - 1] != 0 && maxCount[i - 1] >= 2 && minCount[i - 1] >= 2) {
 
                 // If the modes are within a sample of one another, return the calculated frequency
                 if (std::abs(mode[i - 1] - 2 * mode[i]) <= minDist) {
-                    result.isVoiced = true;
                     result.pitch = fs / mode[i - 1] / (2 << (i - 2));
-                    return;
+                    setConfidence(agreement[i - 1]);
+                    return true;
                 }
             }
         }
     }
 
-    result.isVoiced = false;
+    return false;
+}
+
+int Pitch::DynamicWavelet::findMode(int i, int width, int minDist, double oldMode)
+{
+    const int dCount = differCount;
+
+    // Histogram of the distances, which are all between 1 and width - 1,
+    // summed so that the distances within minDist of any one are counted
+    // in constant time.
+
+    cumulative.head(width + 1).setZero();
+    for (int k = 0; k < dCount; ++k) {
+        cumulative(differs(k) + 1)++;
+    }
+    for (int v = 1; v <= width; ++v) {
+        cumulative(v) += cumulative(v - 1);
+    }
+
+    // Find the center mode of the differences
+
+    int numer = 1; // Require at least two agreeing differs to yield a mode
+    int result = 0; // If none is found, leave as zero
+
+    for (int j = 0; j < dCount; ++j) {
+
+        // Find the # of times that distance j is within minDist samples of another distance
+        const int lo = std::max(differs(j) - minDist, 0);
+        const int hi = std::min(differs(j) + minDist, width - 1);
+        const int numerJ = cumulative(hi + 1) - cumulative(lo);
+
+        // If there are more, set the new standard
+        if (numerJ >= numer && numerJ > floor(width / differs(j)) / 4) {
+            if (numerJ == numer) {
+                if (oldMode != 0 && std::abs(differs(j) - oldMode / (2 << (i - 1))) < minDist) {
+                    result = differs(j);
+                }
+                else if (oldMode == 0 && (differs(j) > 1.95 * result && differs(j) < 2.05 * result)) {
+                    result = differs(j);
+                }
+            }
+            else {
+                numer = numerJ;
+                result = differs(j);
+            }
+        }
+        else if (numerJ == numer - 1 && oldMode != 0 && std::abs(differs(j) - oldMode / (2 << (i - 1))) < minDist) {
+            result = differs(j);
+        }
+    }
+
+    // Set the mode via averaging.
+
+    if (result != 0) {
+        double mean = 0;
+        double meanCount = 0;
+        for (int k = 0; k < dCount; ++k) {
+            if (std::abs(result - differs(k)) <= minDist) {
+                mean += differs(k);
+                meanCount++;
+            }
+        }
+        result = mean / meanCount;
+        agreement[i] = meanCount / dCount;
+    }
+
+    return result;
 }
@@ -0,0 +1,31 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include "Estimator.h"
+
+Pitch::Estimator::Estimator(const Config & config)
+    : cfg(config),
+      lastConfidence(0)
+{
+    candidateList.reserve(MAX_CANDIDATES);
+}
+
+void Pitch::Estimator::beginFrame()
+{
+    lastConfidence = 0;
+    candidateList.clear();
+}
+
+void Pitch::Estimator::addCandidate(double pitch, double confidence)
+{
+    if (candidateList.size() < MAX_CANDIDATES) {
+        candidateList.push_back({pitch, std::clamp(confidence, 0.0, 1.0)});
+    }
+}
+
+void Pitch::Estimator::setConfidence(double confidence)
+{
+    lastConfidence = std::clamp(confidence, 0.0, 1.0);
+}
@@ -4,7 +4,9 @@
 
 #include <cfloat>
 #include "Pitch.h"
+#include "Estimator.h"
 #include "McLeod/MPM.h"
+#include "../Signal/Autocorrelation.h"
 
 using namespace Eigen;
 
@@ -12,13 +14,16 @@ constexpr double cutoff = 0.93;
 constexpr double smallCutoff = 0.3;
 constexpr double lowerPitchCutoff = 60.0;
 
-void Pitch::estimate_MPM(const ArrayXd & x, double fs, Pitch::Estimation & result)
+// Normalises the autocorrelation in place and picks the pitch among its key
+// maxima, whose interpolated lag and height are left in estimates. Returns
+// the index of the chosen estimate, or -1 if the frame is unvoiced.
+static int pickPitch(Ref<ArrayXd> nsdf, double fs, double F0min, double F0max,
+                     std::vector<int> & maxPositions, std::vector<std::pair<double, double>> & estimates)
 {
-    ArrayXd nsdf = MPM::autocorrelation(x);
     nsdf /= nsdf.abs().maxCoeff();
 
-    std::vector<int> maxPositions = MPM::peakPicking(nsdf);
-    std::vector<std::pair<double, double>> estimates;
+    MPM::peakPicking(nsdf, maxPositions);
+    estimates.clear();
 
     double highestAmplitude = -DBL_MAX;
 
@@ -32,28 +37,81 @@ void Pitch::estimate_MPM(const ArrayXd & x, double fs, Pitch::Estimation & resul
     }
 
     if (estimates.empty()) {
-        result.pitch = 0;
-        result.isVoiced = false;
-        return;
+        return -1;
     }
 
     double actualCutoff = cutoff * highestAmplitude;
     double pitch = 0;
+    int chosen = -1;
 
-    for (auto it = estimates.crbegin(); it != estimates.crend(); ++it) {
-        if (std::get<1>(*it) >= actualCutoff) {
-            pitch = fs / std::get<0>(*it);
+    for (int k = estimates.size() - 1; k >= 0; --k) {
+        if (std::get<1>(estimates[k]) >= actualCutoff) {
+            pitch = fs / std::get<0>(estimates[k]);
+            chosen = k;
 
-            if (pitch < lowerPitchCutoff)
+            if (pitch < F0min || pitch > F0max)
                 continue;
             else
                 break;
         }
     }
 
-    if (pitch >= lowerPitchCutoff) {
-        result.pitch = pitch;
+    return (pitch >= F0min && pitch <= F0max) ? chosen : -1;
+}
+
+void Pitch::estimate_MPM(const ArrayXd & x, double fs, Pitch::Estimation & result)
+{
+    estimate_MPM_acorr(Autocorrelation::compute(x), fs, result);
+}
+
+void Pitch::estimate_MPM_acorr(const ArrayXd & acorr, double fs, Pitch::Estimation & result)
+{
+    ArrayXd nsdf = acorr;
+
+    std::vector<int> maxPositions;
+    std::vector<std::pair<double, double>> estimates;
+
+    const int chosen = pickPitch(nsdf, fs, lowerPitchCutoff, DBL_MAX, maxPositions, estimates);
+
+    if (chosen >= 0) {
+        result.pitch = fs / std::get<0>(estimates[chosen]);
+        result.isVoiced = true;
+    }
+    else {
+        result.pitch = 0;
+        result.isVoiced = false;
+    }
+}
+
+Pitch::McLeodEstimator::McLeodEstimator(const Config & config)
+    : Estimator(config),
+      forward(Autocorrelation::fastSize(2 * config.frameLength)),
+      backward(forward.size()),
+      nsdf(config.frameLength)
+{
+    // There is at most one key maximum per two lags.
+    maxPositions.reserve(config.frameLength / 2 + 1);
+    estimates.reserve(config.frameLength / 2 + 1);
+}
+
+void Pitch::McLeodEstimator::estimate(const ArrayXd & x, Pitch::Estimation & result)
+{
+    const double fs = cfg.sampleRate;
+
+    beginFrame();
+
+    Autocorrelation::compute(x, nsdf, forward, backward);
+
+    const int chosen = pickPitch(nsdf, fs, cfg.F0min, cfg.F0max, maxPositions, estimates);
+
+    for (const auto & [lag, clarity] : estimates) {
+        addCandidate(fs / lag, clarity);
+    }
+
+    if (chosen >= 0) {
+        result.pitch = fs / std::get<0>(estimates[chosen]);
         result.isVoiced = true;
+        setConfidence(std::get<1>(estimates[chosen]));
     }
     else {
         result.pitch = 0;
@@ -1,18 +1,102 @@
 #include "Pitch.h"
+#include "Estimator.h"
 #include "Yin/YIN.h"
+#include "../Signal/Autocorrelation.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 using namespace Eigen;
 
 void Pitch::estimate_YIN(const ArrayXd & x, double fs, Pitch::Estimation & result, double threshold)
 {
-    ArrayXd diff = YIN::difference(x);
-    ArrayXd cmnd = YIN::cumulative_mean_normalized_difference(diff);
-    int tau = YIN::absolute_threshold(cmnd, threshold);
+    // The one buffer of the estimate: the difference function becomes the
+    // normalised difference in place.
+    ArrayXd d(x.size() / 2);
+
+    YIN::difference(x, d);
+
+    const double tau = YIN::period(d, threshold);
+
+    if (tau > 0) {
+        result.isVoiced = true;
+        result.pitch = fs / tau;
+    }
+    else {
+        result.isVoiced = false;
+        result.pitch = -1;
+    }
+}
+
+void Pitch::estimate_YIN(const ArrayXd & x, double fs, Pitch::Estimation & result, double threshold, double F0min)
+{
+    const double tau = YIN::period_direct(x, threshold, std::ceil(fs / F0min));
+
+    if (tau > 0) {
+        result.isVoiced = true;
+        result.pitch = fs / tau;
+    }
+    else {
+        result.isVoiced = false;
+        result.pitch = -1;
+    }
+}
+
+Pitch::YinEstimator::YinEstimator(const Config & config, double _threshold)
+    : Estimator(config),
+      threshold(_threshold),
+      forward(Autocorrelation::fastSize(config.frameLength)),
+      backward(forward.size()),
+      d(std::min<int>(std::ceil(config.sampleRate / config.F0min) + 2, config.frameLength / 2))
+{
+}
+
+void Pitch::YinEstimator::estimate(const ArrayXd & x, Pitch::Estimation & result)
+{
+    const double fs = cfg.sampleRate;
+
+    beginFrame();
+
+    YIN::difference(x, d, forward, backward);
+
+    double minimum;
+    const double tau = YIN::period(d, threshold, &minimum);
+
+    if (tau > 0 && fs / tau <= cfg.F0max) {
+        addCandidate(fs / tau, 1 - minimum);
+        setConfidence(1 - minimum);
+
+        result.isVoiced = true;
+        result.pitch = fs / tau;
+    }
+    else {
+        result.isVoiced = false;
+        result.pitch = -1;
+    }
+}
+
+Pitch::FastYinEstimator::FastYinEstimator(const Config & config, double _threshold)
+    : Estimator(config),
+      threshold(_threshold),
+      maxLag(std::ceil(config.sampleRate / config.F0min))
+{
+}
+
+void Pitch::FastYinEstimator::estimate(const ArrayXd & x, Pitch::Estimation & result)
+{
+    const double fs = cfg.sampleRate;
+
+    beginFrame();
+
+    double minimum;
+    const double tau = YIN::period_direct(x, threshold, maxLag, &minimum);
+
+    if (tau > 0 && fs / tau <= cfg.F0max) {
+        addCandidate(fs / tau, 1 - minimum);
+        setConfidence(1 - minimum);
 
-    if (tau != -1) {
         result.isVoiced = true;
-        result.pitch = fs / YIN::parabolic_interpolation(cmnd, tau);
+        result.pitch = fs / tau;
     }
     else {
         result.isVoiced = false;
@@ -3,16 +3,33 @@
 
 #include <Eigen/Dense>
 #include <utility>
+#include "../../FFT/FFT.h"
 
 namespace YIN
 {
-    Eigen::ArrayXd autocorrelation(Eigen::Ref<const Eigen::ArrayXd> x);
-
+    // Difference function d(tau) = sum_{j < W} (x(j) - x(j + tau))^2 over a
+    // window of W = x.size() / 2 samples, for tau = 0 .. d.size() - 1 with
+    // d.size() <= W. The energy terms are running sums and the cross term
+    // is one real-FFT cross-correlation, using the calling thread's cached
+    // plans of size Autocorrelation::fastSize(x.size()).
+    void difference(Eigen::Ref<const Eigen::ArrayXd> x, Eigen::Ref<Eigen::ArrayXd> d);
     Eigen::ArrayXd difference(const Eigen::ArrayXd & x);
 
-    Eigen::ArrayXd cumulative_mean_normalized_difference(const Eigen::ArrayXd & x);
+    // With the caller's plans, both of size Autocorrelation::fastSize(x.size()).
+    void difference(Eigen::Ref<const Eigen::ArrayXd> x, Eigen::Ref<Eigen::ArrayXd> d, RCFFTPlan & forward, CRFFTPlan & backward);
+
+    // Turns d into the cumulative mean normalised difference in place, up to
+    // the first dip below threshold, and returns the lag of that dip refined
+    // by parabolic interpolation, or -1 if there is none. If there is one and
+    // `minimum` is given, it is set to the normalised difference at the dip.
+    double period(Eigen::Ref<Eigen::ArrayXd> d, double threshold, double * minimum = nullptr);
 
-    int absolute_threshold(const Eigen::ArrayXd & x, double threshold);
+    // Same as difference() followed by period(), but computes d(tau) lag by
+    // lag in the time domain and stops one lag after the bottom of the first
+    // dip. Lags beyond maxLag + 1 are never computed, so the cost is at most
+    // (maxLag + 1) x.size() / 2 multiply-adds, and a dip past maxLag is not
+    // found.
+    double period_direct(Eigen::Ref<const Eigen::ArrayXd> x, double threshold, int maxLag, double * minimum = nullptr);
 
     double parabolic_interpolation(Eigen::Ref<const Eigen::ArrayXd> array, int x);
 }
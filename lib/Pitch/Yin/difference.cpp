@@ -1,18 +1,55 @@
 #include "YIN.h"
+#include "../../FFT/FFT.h"
+#include "../../Signal/Autocorrelation.h"
 
 using namespace Eigen;
 
 ArrayXd YIN::difference(const ArrayXd & x)
+{
+    ArrayXd d(x.size() / 2);
+    difference(x, d);
+    return d;
+}
+
+void YIN::difference(Ref<const ArrayXd> x, Ref<ArrayXd> d)
+{
+    // The lags stay below N - W, so a circular correlation of N points
+    // does not wrap around.
+    const int nfft = Autocorrelation::fastSize(x.size());
+
+    difference(x, d, fft_cached_plan<RCFFT>(nfft), fft_cached_plan<CRFFT>(nfft));
+}
+
+void YIN::difference(Ref<const ArrayXd> x, Ref<ArrayXd> d, RCFFTPlan & forward, CRFFTPlan & backward)
 {
     const int N = x.size();
+    const int W = N / 2;
+    const int nlags = d.size();
+    const int nfft = forward.size();
 
-    ArrayXd acorr = autocorrelation(x);
+    // c(tau) = sum_{j < W} x(j) x(j + tau)
+    forward.input().head(W) = x.head(W);
+    forward.input().tail(nfft - W).setZero();
+    forward.execute();
 
-    ArrayXd yin_buffer(N / 2);
+    backward.input() = forward.output().conjugate();
 
-    for (int tau = 0; tau < N / 2; ++tau) {
-        yin_buffer(tau) = acorr(0) + acorr(1) - 2 * acorr(tau);
-    }
+    forward.input().head(N) = x;
+    forward.input().tail(nfft - N).setZero();
+    forward.execute();
+
+    backward.input() *= forward.output();
+    backward.execute();
 
-    return std::move(yin_buffer);
+    const auto c = backward.output().head(nlags) / double(nfft);
+
+    // d(tau) = e(0) + e(tau) - 2 c(tau), where e(tau) is the energy of
+    // x(tau) .. x(tau + W - 1).
+    const double e0 = x.head(W).square().sum();
+    double e = e0;
+
+    for (int tau = 0; tau < nlags; ++tau) {
+        d(tau) = std::max(e0 + e - 2 * c(tau), 0.0);
+        e += x(tau + W) * x(tau + W) - x(tau) * x(tau);
+    }
 }
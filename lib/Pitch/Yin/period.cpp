@@ -0,0 +1,46 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include "YIN.h"
+
+using namespace Eigen;
+
+double YIN::period(Ref<ArrayXd> d, double threshold, double * minimum)
+{
+    const int halfN = d.size();
+
+    double runningSum = 0;
+    int tau = -1;
+
+    d(0) = 1;
+
+    for (int t = 1; t < halfN; ++t) {
+        runningSum += d(t);
+        d(t) = runningSum > 0 ? (t * d(t)) / runningSum : 1;
+
+        if (tau < 0) {
+            if (t >= 2 && d(t) < threshold) {
+                tau = t;
+            }
+        }
+        else if (d(t) < d(tau)) {
+            // Follow the dip down to its minimum.
+            tau = t;
+        }
+        else {
+            break;
+        }
+    }
+
+    if (tau < 0) {
+        return -1;
+    }
+
+    if (minimum != nullptr) {
+        *minimum = d(tau);
+    }
+
+    // Only the lags up to the one after the dip are normalised.
+    return parabolic_interpolation(d.head(std::min(tau + 2, halfN)), tau);
+}
@@ -0,0 +1,62 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include "YIN.h"
+
+using namespace Eigen;
+
+double YIN::period_direct(Ref<const ArrayXd> x, double threshold, int maxLag, double * minimum)
+{
+    const int W = x.size() / 2;
+    const int nlags = std::min(maxLag + 2, W);
+
+    const auto head = x.head(W);
+
+    // Normalised difference at the lags before, at and after the dip.
+    Array3d around;
+
+    double runningSum = 0;
+    double previous = 1;
+    int tau = -1;
+
+    for (int t = 1; t < nlags; ++t) {
+        const double d = (head - x.segment(t, W)).square().sum();
+
+        runningSum += d;
+        const double cmnd = runningSum > 0 ? (t * d) / runningSum : 1;
+
+        if (tau < 0) {
+            if (t >= 2 && cmnd < threshold) {
+                tau = t;
+                around(0) = previous;
+                around(1) = cmnd;
+            }
+        }
+        else if (cmnd < around(1)) {
+            // Follow the dip down to its minimum.
+            tau = t;
+            around(0) = around(1);
+            around(1) = cmnd;
+        }
+        else {
+            around(2) = cmnd;
+            break;
+        }
+
+        previous = cmnd;
+    }
+
+    if (tau < 0) {
+        return -1;
+    }
+
+    if (minimum != nullptr) {
+        *minimum = around(1);
+    }
+
+    // Only two lags are known if the dip runs into the last lag.
+    const int known = (tau + 1 < nlags) ? 3 : 2;
+    return tau - 1 + parabolic_interpolation(around.head(known), 1);
+}
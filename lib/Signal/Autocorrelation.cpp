@@ -0,0 +1,89 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include "Autocorrelation.h"
+#include "../FFT/FFT.h"
+
+using namespace Eigen;
+
+int Autocorrelation::fastSize(int n)
+{
+    int best = 1;
+    while (best < n) {
+        best *= 2;
+    }
+
+    for (int p5 = 1; p5 < best; p5 *= 5) {
+        for (int p35 = p5; p35 < best; p35 *= 3) {
+            int m = p35;
+            while (m < n) {
+                m *= 2;
+            }
+            best = std::min(best, m);
+        }
+    }
+
+    return best;
+}
+
+template<typename Real>
+static void autocorrelate(Ref<const Array<Real, Dynamic, 1>> x, Ref<Array<Real, Dynamic, 1>> r,
+                          FFTPlan<RCFFT, Real> & forward, FFTPlan<CRFFT, Real> & backward)
+{
+    using Complex = std::complex<Real>;
+
+    const int n = x.size();
+    const int nfft = forward.size();
+    const int nbins = nfft / 2 + 1;
+
+    Map<Array<Real, Dynamic, 1>> in(forward.in(), nfft);
+    in.head(n) = x;
+    in.tail(nfft - n).setZero();
+
+    forward.execute();
+
+    Map<Array<Complex, Dynamic, 1>>(backward.in(), nbins) = Map<Array<Complex, Dynamic, 1>>(forward.out(), nbins).abs2().template cast<Complex>();
+
+    backward.execute();
+
+    r = Map<Array<Real, Dynamic, 1>>(backward.out(), r.size()) / static_cast<Real>(nfft);
+}
+
+template<typename Real>
+static void autocorrelate(Ref<const Array<Real, Dynamic, 1>> x, Ref<Array<Real, Dynamic, 1>> r)
+{
+    const int nfft = Autocorrelation::fastSize(2 * x.size());
+
+    autocorrelate<Real>(x, r, fft_cached_plan<RCFFT, Real>(nfft), fft_cached_plan<CRFFT, Real>(nfft));
+}
+
+void Autocorrelation::compute(Ref<const ArrayXd> x, Ref<ArrayXd> r)
+{
+    autocorrelate<double>(x, r);
+}
+
+void Autocorrelation::compute(Ref<const ArrayXf> x, Ref<ArrayXf> r)
+{
+    autocorrelate<float>(x, r);
+}
+
+void Autocorrelation::compute(Ref<const ArrayXd> x, Ref<ArrayXd> r, RCFFTPlan & forward, CRFFTPlan & backward)
+{
+    autocorrelate<double>(x, r, forward, backward);
+}
+
+ArrayXd Autocorrelation::compute(Ref<const ArrayXd> x)
+{
+    ArrayXd r(x.size());
+    compute(x, r);
+    return r;
+}
+
+ArrayXf Autocorrelation::compute(Ref<const ArrayXf> x)
+{
+    ArrayXf r(x.size());
+    compute(x, r);
+    return r;
+}
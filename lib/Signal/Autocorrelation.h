@@ -0,0 +1,31 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_AUTOCORRELATION_H
+#define SPEECH_ANALYSIS_AUTOCORRELATION_H
+
+#include <Eigen/Core>
+#include "../FFT/FFT.h"
+
+namespace Autocorrelation {
+
+    // Smallest size of the form 2^a 3^b 5^c that is at least n.
+    int fastSize(int n);
+
+    // Linear autocorrelation r(k) = sum_j x(j) x(j + k) for k = 0 .. r.size() - 1,
+    // with r.size() <= x.size(). Computed with real transforms zero-padded to
+    // fastSize(2 * x.size()), using the calling thread's cached plans.
+    void compute(Eigen::Ref<const Eigen::ArrayXd> x, Eigen::Ref<Eigen::ArrayXd> r);
+    void compute(Eigen::Ref<const Eigen::ArrayXf> x, Eigen::Ref<Eigen::ArrayXf> r);
+
+    // With the caller's plans, both of size fastSize(2 * x.size()).
+    void compute(Eigen::Ref<const Eigen::ArrayXd> x, Eigen::Ref<Eigen::ArrayXd> r, RCFFTPlan & forward, CRFFTPlan & backward);
+
+    // All lags, from 0 to x.size() - 1.
+    Eigen::ArrayXd compute(Eigen::Ref<const Eigen::ArrayXd> x);
+    Eigen::ArrayXf compute(Eigen::Ref<const Eigen::ArrayXf> x);
+
+}
+
+#endif //SPEECH_ANALYSIS_AUTOCORRELATION_H
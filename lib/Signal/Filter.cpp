@@ -45,18 +45,29 @@ void Filter::responseIIR(const ArrayXd & b, const ArrayXd & a, const ArrayXd & f
 
 }
 
-void Filter::preEmphasis(ArrayXd & x, double samplingFrequency, double preEmphasisFrequency)
+template<typename Real>
+static void applyPreEmphasis(Array<Real, Dynamic, 1> & x, double samplingFrequency, double preEmphasisFrequency)
 {
     if (preEmphasisFrequency >= 0.5 * samplingFrequency)
         return;
 
-    const double preEmphasis = exp(-2.0 * M_PI * preEmphasisFrequency / samplingFrequency);
+    const Real preEmphasis = exp(-2.0 * M_PI * preEmphasisFrequency / samplingFrequency);
 
     for (int i = x.size() - 1; i >= 1; --i) {
         x(i) -= preEmphasis * x(i - 1);
     }
 }
 
+void Filter::preEmphasis(ArrayXd & x, double samplingFrequency, double preEmphasisFrequency)
+{
+    applyPreEmphasis(x, samplingFrequency, preEmphasisFrequency);
+}
+
+void Filter::preEmphasis(ArrayXf & x, double samplingFrequency, double preEmphasisFrequency)
+{
+    applyPreEmphasis(x, samplingFrequency, preEmphasisFrequency);
+}
+
 void Filter::apply(const Eigen::ArrayXd & b, const Eigen::ArrayXd & x, Eigen::ArrayXd & y)
 {
     y.resize(x.size());
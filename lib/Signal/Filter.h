@@ -14,6 +14,7 @@ namespace Filter {
     void responseIIR(const Eigen::ArrayXd & b, const Eigen::ArrayXd & a, const Eigen::ArrayXd & f, double fs, Eigen::ArrayXcd & h);
 
     void preEmphasis(Eigen::ArrayXd & x, double samplingFrequency, double preEmphasisFrequency);
+    void preEmphasis(Eigen::ArrayXf & x, double samplingFrequency, double preEmphasisFrequency);
 
     void apply(const Eigen::ArrayXd & b, const Eigen::ArrayXd & x, Eigen::ArrayXd & y);
     void apply(const Eigen::ArrayXd & b, const Eigen::ArrayXd & a, const Eigen::ArrayXd & x, Eigen::ArrayXd & y);
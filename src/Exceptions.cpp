@@ -4,7 +4,6 @@
 
 #include <cstdio>
 #include "Exceptions.h"
-#include "log/simpleQtLogger.h"
 
 GenericException::GenericException(const char * prefix, const char * msg) {
 
@@ -32,4 +32,9 @@ public:
     AudioException(const char * msg) : GenericException("Audio", msg) {}
 };
 
+class FileException : public GenericException {
+public:
+    FileException(const char * msg) : GenericException("File", msg) {}
+};
+
 #endif //SPEECH_ANALYSIS_EXCEPTIONS_H
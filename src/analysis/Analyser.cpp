@@ -5,36 +5,31 @@
 #include <QSettings>
 #include "Analyser.h"
 #include "../log/simpleQtLogger.h"
+#include "../log/Trace.h"
 #include "../Exceptions.h"
 
 using namespace Eigen;
 
-static const Formant::Frame defaultFrame = {
-    .nFormants = 5,
-    .formant = {{550, 60}, {1650, 60}, {2750, 60}, {3850, 60}, {4950, 60}},
-    .intensity = 1.0,
-};
-
-static const SpecFrame defaultSpec = {
-    .fs = 16000,
-    .nfft = 512,
-    .spec = ArrayXd::Zero(512),
-};
-
 Analyser::Analyser(AudioInterface * audioInterface)
     : audioInterface(audioInterface),
+      engine(audioInterface->getSampleRate()),
       doAnalyse(true),
       running(false),
-      lpFailed(true),
+      lastOverrunCount(0),
+      nextFrameEnd(0),
+      lastFrameEnd(0),
+      resyncCapture(true),
       frameCount(0),
-      nfft(1),
       frameLength(25),
       windowSpan(1),
       frameSpace(10),
       nsamples(0),
-      maximumFrequency(3700)
+      planStopping(false)
 {
-    _initResampler();
+    planThread = std::thread(&Analyser::planLoop, this);
+
+    engine.setFrameCallback([this](const AnalysisFrame & frame) { commitFrame(frame); });
+
     loadSettings();
 
     setInputDevice(nullptr);
@@ -44,8 +39,47 @@ Analyser::~Analyser() {
     if (isAnalysing()) {
         stopThread();
     }
+    // No more frames may be committed into the tracks from here on.
+    engine.setFrameCallback(nullptr);
     saveSettings();
-    ma_resampler_uninit(&resampler);
+
+    {
+        std::lock_guard<std::mutex> lock(planLock);
+        planStopping = true;
+    }
+    planRequested.notify_one();
+    planThread.join();
+}
+
+void Analyser::planLoop()
+{
+    Trace::setThreadName("fft planner");
+
+    std::unique_lock<std::mutex> lock(planLock);
+
+    while (true) {
+        planRequested.wait(lock, [this] { return planStopping || pendingPlan; });
+
+        if (planStopping) {
+            return;
+        }
+
+        auto task = std::move(pendingPlan);
+        pendingPlan = nullptr;
+
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+}
+
+void Analyser::schedulePlanning(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(planLock);
+        pendingPlan = std::move(task);
+    }
+    planRequested.notify_one();
 }
 
 void Analyser::startThread() {
@@ -56,6 +90,7 @@ void Analyser::startThread() {
 void Analyser::stopThread() {
     running.store(false);
     thread.join();
+    engine.wait();
 }
 
 void Analyser::toggle(bool running) {
@@ -72,8 +107,8 @@ void Analyser::setInputDevice(const ma_device_id * id) {
     std::lock_guard<std::mutex> guard(audioLock);
     audioInterface->closeStream();
     audioInterface->openInputDevice(id);
-    fs = audioInterface->getSampleRate();
-    x.setZero(CAPTURE_SAMPLE_COUNT(fs));
+    x.setZero(CAPTURE_SAMPLE_COUNT(audioInterface->getSampleRate()));
+    resyncCapture = true;
     audioInterface->startStream();
 }
 
@@ -81,8 +116,8 @@ void Analyser::setOutputDevice(const ma_device_id * id) {
     std::lock_guard<std::mutex> guard(audioLock);
     audioInterface->closeStream();
     audioInterface->openOutputDevice(id);
-    fs = audioInterface->getSampleRate();
-    x.setZero(CAPTURE_SAMPLE_COUNT(fs));
+    x.setZero(CAPTURE_SAMPLE_COUNT(audioInterface->getSampleRate()));
+    resyncCapture = true;
     audioInterface->startStream();
 }
 
@@ -92,57 +127,57 @@ double Analyser::getSampleRate() {
 
 void Analyser::setFftSize(int _nfft) {
     std::lock_guard<std::mutex> lock(paramLock);
-    nfft = _nfft;
-    LS_INFO("Set FFT size to " << nfft);
+    engine.setFftSize(_nfft);
+    LS_INFO("Set FFT size to " << engine.getFftSize());
     
     _updateCaptureDuration();
 }
 
 int Analyser::getFftSize() {
     std::lock_guard<std::mutex> lock(paramLock);
-    return nfft;
+    return engine.getFftSize();
 }
 
 void Analyser::setLinearPredictionOrder(int _lpOrder) {
     std::lock_guard<std::mutex> lock(paramLock);
-    lpOrder = std::clamp(_lpOrder, 5, 22);
-    LS_INFO("Set LP order to " << lpOrder);
+    engine.setLinearPredictionOrder(_lpOrder);
+    LS_INFO("Set LP order to " << engine.getLinearPredictionOrder());
 }
 
 int Analyser::getLinearPredictionOrder() {
     std::lock_guard<std::mutex> lock(paramLock);
-    return lpOrder;
+    return engine.getLinearPredictionOrder();
 }
 
 void Analyser::setCepstralOrder(int _cepOrder) {
     std::lock_guard<std::mutex> lock(paramLock);
     
-    cepOrder = std::clamp(_cepOrder, 7, 25);
-    LS_INFO("Set LPCC order to " << cepOrder);
-
-    _initEkfState(); 
+    engine.setCepstralOrder(_cepOrder);
+    LS_INFO("Set LPCC order to " << engine.getCepstralOrder());
 }
 
 int Analyser::getCepstralOrder() {
     std::lock_guard<std::mutex> lock(paramLock);
-    return cepOrder;
+    return engine.getCepstralOrder();
 }
 
 void Analyser::setMaximumFrequency(double _maximumFrequency) {
     std::lock_guard<std::mutex> lock(paramLock);
-    maximumFrequency = std::clamp(_maximumFrequency, 2500.0, 7000.0);
-   
-    LS_INFO("Set maximum frequency to " << maximumFrequency);
 
-    if (ma_resampler_set_rate(&resampler, audioInterface->getSampleRate(), 2 * maximumFrequency) != MA_SUCCESS) {
+    try {
+        engine.setMaximumFrequency(_maximumFrequency);
+    }
+    catch (const AudioException &) {
         LS_FATAL("Unable to change resampler output rate");
-        throw AudioException("Unable to change resampler output rate");
+        throw;
     }
+   
+    LS_INFO("Set maximum frequency to " << engine.getMaximumFrequency());
 }
 
 double Analyser::getMaximumFrequency() {
     std::lock_guard<std::mutex> lock(paramLock);
-    return maximumFrequency;
+    return engine.getMaximumFrequency();
 }
 
 void Analyser::setFrameLength(const std::chrono::duration<double, std::milli> & _frameLength) {
@@ -188,9 +223,9 @@ const std::chrono::duration<double> & Analyser::getWindowSpan() {
 
 void Analyser::setPitchAlgorithm(enum PitchAlg _pitchAlg) {
     std::lock_guard<std::mutex> lock(paramLock);
-    pitchAlg = _pitchAlg;
+    engine.setPitchAlgorithm(_pitchAlg);
 
-    switch (pitchAlg) {
+    switch (_pitchAlg) {
         case Wavelet:
             L_INFO("Set pitch algorithm to DynamicWavelet");
             break;
@@ -203,19 +238,22 @@ void Analyser::setPitchAlgorithm(enum PitchAlg _pitchAlg) {
         case AMDF:
             L_INFO("Set pitch algorithm to AMDF");
             break;
+        case FastYIN:
+            L_INFO("Set pitch algorithm to Yin (time domain)");
+            break;
     }
 }
 
 PitchAlg Analyser::getPitchAlgorithm() {
     std::lock_guard<std::mutex> lock(paramLock);
-    return pitchAlg;
+    return engine.getPitchAlgorithm();
 }
 
 void Analyser::setFormantMethod(enum FormantMethod _method) {
     std::lock_guard<std::mutex> lock(paramLock);
-    formantMethod = _method;
+    engine.setFormantMethod(_method);
 
-    switch (formantMethod) {
+    switch (_method) {
         case LP:
             L_INFO("Set formant algorithm to Linear Prediction");
             break;
@@ -227,7 +265,68 @@ void Analyser::setFormantMethod(enum FormantMethod _method) {
 
 FormantMethod Analyser::getFormantMethod() {
     std::lock_guard<std::mutex> lock(paramLock);
-    return formantMethod;
+    return engine.getFormantMethod();
+}
+
+void Analyser::setSpectrumBins(int _spectrumBins) {
+    std::lock_guard<std::mutex> lock(paramLock);
+    engine.setSpectrumBins(_spectrumBins);
+
+    if (engine.getSpectrumBins() > 0) {
+        LS_INFO("Set spectrum to " << engine.getSpectrumBins() << " bins up to the maximum frequency");
+    }
+    else {
+        L_INFO("Set spectrum to the full band");
+    }
+
+    _updateCaptureDuration();
+}
+
+int Analyser::getSpectrumBins() {
+    std::lock_guard<std::mutex> lock(paramLock);
+    return engine.getSpectrumBins();
+}
+
+void Analyser::setSpectrumAveraging(int _frames) {
+    std::lock_guard<std::mutex> lock(paramLock);
+    engine.setSpectrumAveraging(_frames);
+    LS_INFO("Set spectrum averaging to " << engine.getSpectrumAveraging() << " frames");
+}
+
+int Analyser::getSpectrumAveraging() {
+    std::lock_guard<std::mutex> lock(paramLock);
+    return engine.getSpectrumAveraging();
+}
+
+void Analyser::setSlidingSpectrum(bool _slidingSpectrum) {
+    std::lock_guard<std::mutex> lock(paramLock);
+    engine.setSlidingSpectrum(_slidingSpectrum);
+    LS_INFO("Set sliding spectrum " << (engine.getSlidingSpectrum() ? "on" : "off"));
+
+    _updateCaptureDuration();
+}
+
+bool Analyser::getSlidingSpectrum() {
+    std::lock_guard<std::mutex> lock(paramLock);
+    return engine.getSlidingSpectrum();
+}
+
+void Analyser::setExtraFftSizes(const std::vector<int> & _sizes) {
+    std::lock_guard<std::mutex> lock(paramLock);
+    engine.setExtraFftSizes(_sizes);
+
+    QStringList sizes;
+    for (int size : engine.getExtraFftSizes()) {
+        sizes << QString::number(size);
+    }
+    LS_INFO("Set extra FFT sizes to {" << sizes.join(", ") << "}");
+
+    _updateCaptureDuration();
+}
+
+std::vector<int> Analyser::getExtraFftSizes() {
+    std::lock_guard<std::mutex> lock(paramLock);
+    return engine.getExtraFftSizes();
 }
 
 int Analyser::getFrameCount() {
@@ -237,32 +336,32 @@ int Analyser::getFrameCount() {
     return frameCount;
 }
 
-const SpecFrame & Analyser::getSpectrumFrame(int _iframe) {
+const SpecFrame & Analyser::getSpectrumFrame(int _iframe, int resolution) {
     std::lock_guard<std::mutex> lock(mutex);
 
     int iframe = std::clamp(_iframe, 0, frameCount - 1);
-    return spectra.at(iframe);
+    return tracks.spectra(resolution)[iframe];
 }
 
-const Formant::Frame & Analyser::getFormantFrame(int _iframe) {
+Formant::Frame Analyser::getFormantFrame(int _iframe) {
     std::lock_guard<std::mutex> lock(mutex);
 
     int iframe = std::clamp(_iframe, 0, frameCount - 1);
-    return smoothedFormants.at(iframe);
+    return tracks.formantFrame(iframe);
 }
 
 double Analyser::getPitchFrame(int _iframe) {
     std::lock_guard<std::mutex> lock(mutex);
 
     int iframe = std::clamp(_iframe, 0, frameCount - 1);
-    return smoothedPitch.at(iframe);
+    return tracks.pitch()[iframe];
 }
 
 double Analyser::getOqFrame(int _iframe) {
     std::lock_guard<std::mutex> lock(mutex);
 
     int iframe = std::clamp(_iframe, 0, frameCount - 1);
-    return oqTrack.at(iframe);
+    return tracks.oq()[iframe];
 }
 
 void Analyser::_updateFrameCount() {
@@ -270,28 +369,7 @@ void Analyser::_updateFrameCount() {
 
     const int newFrameCount = (1000 * windowSpan.count()) / frameSpace.count();
 
-    if (frameCount < newFrameCount) {
-        int diff = newFrameCount - frameCount;
-
-        pitchTrack.insert(pitchTrack.begin(), diff, 0.0);
-        formantTrack.insert(formantTrack.begin(), diff, defaultFrame);
-
-        spectra.insert(spectra.begin(), diff, defaultSpec);
-        smoothedPitch.insert(smoothedPitch.begin(), diff, 0.0);
-        smoothedFormants.insert(smoothedFormants.begin(), diff, defaultFrame);
-        oqTrack.insert(oqTrack.begin(), diff, 0.0);
-    }
-    else if (frameCount > newFrameCount) {
-        int diff = frameCount - newFrameCount;
-
-        pitchTrack.erase(pitchTrack.begin(), pitchTrack.begin() + diff);
-        formantTrack.erase(formantTrack.begin(), formantTrack.begin() + diff);
-        
-        spectra.erase(spectra.begin(), spectra.begin() + diff);
-        smoothedPitch.erase(smoothedPitch.begin(), smoothedPitch.begin() + diff);
-        smoothedFormants.erase(smoothedFormants.begin(), smoothedFormants.begin() + diff);
-        oqTrack.erase(oqTrack.begin(), oqTrack.begin() + diff);
-    }
+    tracks.resize(newFrameCount);
 
     LS_INFO("Resized tracks from " << frameCount << " to " << newFrameCount);
 
@@ -305,49 +383,20 @@ void Analyser::_updateCaptureDuration()
     double fs = audioInterface->getSampleRate();
 
     // Account for resampling.
-    fftSamples = nfft; //(fs * nfft) / refs;
+    fftSamples = engine.getCaptureFftSize(); //(fs * nfft) / refs;
     frameSamples = frameLength.count() / 1000.0 * fs;
 
     int nsamples = std::max(fftSamples, frameSamples);
     if (nsamples != this->nsamples) {
         audioInterface->setCaptureDuration(nsamples);
         this->nsamples = nsamples;
+        resyncCapture = true;
 
         LS_INFO("Set capture duration to " << nsamples << " samples (" << (1000.0 * nsamples / fs) << " ms)");
     }
-}
-
-void Analyser::_initEkfState()
-{
-    int numF = 3;
 
-    VectorXd x0(2 * numF);
-    x0.setZero();
-
-    for (int k = 0; k < numF; ++k) {
-        x0(k) = 550 + 600 * k;
-        x0(numF + k) = 90 + 20 * k;
-    }
-
-    ekfState.cepOrder = this->cepOrder;
-
-    EKF::init(ekfState, x0);
-}
-
-void Analyser::_initResampler()
-{
-    ma_resampler_config config = ma_resampler_config_init(
-            ma_format_f32,
-            1,
-            audioInterface->getSampleRate(),
-            2 * maximumFrequency,
-            ma_resample_algorithm_speex);
-    config.speex.quality = 10;
-
-    if (ma_resampler_init(&config, &resampler) != MA_SUCCESS) {
-        LS_FATAL("Unable to initialise resampler");
-        throw AudioException("Unable to initialise resampler");
-    }
+    // Only the sizes are read here; the planning itself happens later.
+    schedulePlanning(engine.transformPreparation(frameSamples));
 }
 
 void Analyser::loadSettings()
@@ -359,7 +408,7 @@ void Analyser::loadSettings()
     settings.beginGroup("analysis");
 
     setMaximumFrequency(settings.value("maxFreq", 4700.0).value<double>());
-    nfft = settings.value("fftSize", 512).value<int>();
+    engine.setFftSize(settings.value("fftSize", 512).value<int>());
     setLinearPredictionOrder(settings.value("lpOrder", 12).value<int>());
     frameLength = std::chrono::milliseconds(settings.value("frameLength", 35).value<int>());
     _updateCaptureDuration();
@@ -368,6 +417,15 @@ void Analyser::loadSettings()
     setPitchAlgorithm((PitchAlg) settings.value("pitchAlg", static_cast<int>(Wavelet)).value<int>());
     setFormantMethod((FormantMethod) settings.value("formantMethod", static_cast<int>(KARMA)).value<int>());
     setCepstralOrder(settings.value("cepOrder", 15).value<int>());
+    setSpectrumBins(settings.value("spectrumBins", 0).value<int>());
+    setSpectrumAveraging(settings.value("spectrumAveraging", 1).value<int>());
+    setSlidingSpectrum(settings.value("slidingSpectrum", false).value<bool>());
+
+    std::vector<int> extraFftSizes;
+    for (const auto & size : settings.value("extraFftSizes").toList()) {
+        extraFftSizes.push_back(size.toInt());
+    }
+    setExtraFftSizes(extraFftSizes);
 
     settings.endGroup();
 }
@@ -380,15 +438,24 @@ void Analyser::saveSettings()
 
     settings.beginGroup("analysis");
 
-    settings.setValue("maxFreq", maximumFrequency);
-    settings.setValue("fftSize", nfft);
-    settings.setValue("lpOrder", lpOrder);
-    settings.setValue("cepOrder", cepOrder);
+    settings.setValue("maxFreq", engine.getMaximumFrequency());
+    settings.setValue("fftSize", engine.getFftSize());
+    settings.setValue("lpOrder", engine.getLinearPredictionOrder());
+    settings.setValue("cepOrder", engine.getCepstralOrder());
     settings.setValue("frameLength", frameLength.count());
     settings.setValue("frameSpace", frameSpace.count());
     settings.setValue("windowSpan", windowSpan.count());
-    settings.setValue("pitchAlg", static_cast<int>(pitchAlg));
-    settings.setValue("formantMethod", static_cast<int>(formantMethod));
+    settings.setValue("pitchAlg", static_cast<int>(engine.getPitchAlgorithm()));
+    settings.setValue("formantMethod", static_cast<int>(engine.getFormantMethod()));
+    settings.setValue("spectrumBins", engine.getSpectrumBins());
+    settings.setValue("spectrumAveraging", engine.getSpectrumAveraging());
+    settings.setValue("slidingSpectrum", engine.getSlidingSpectrum());
+
+    QVariantList extraFftSizes;
+    for (int size : engine.getExtraFftSizes()) {
+        extraFftSizes.append(size);
+    }
+    settings.setValue("extraFftSizes", extraFftSizes);
 
     settings.endGroup();
 
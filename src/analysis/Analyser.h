@@ -8,31 +8,39 @@
 #include "../audio/miniaudio.h"
 #include <QColor>
 #include <Eigen/Core>
+#include <array>
+#include <condition_variable>
 #include <deque>
+#include <functional>
 #include <thread>
 #include <memory>
 #include <map>
 #include "../audio/AudioInterface.h"
 #include "../audio/AudioDevices.h"
-#include "../lib/Formant/Formant.h"
-#include "../lib/Formant/EKF/EKF.h"
+#include "AnalysisEngine.h"
+#include "TrackStore.h"
+#include "TripleBuffer.h"
 
-struct SpecFrame {
-    double fs;
-    int nfft;
-    Eigen::ArrayXd spec;
-};
-
-enum PitchAlg {
-    Wavelet = 0,
-    McLeod,
-    YIN,
-    AMDF,
-};
-
-enum FormantMethod {
-    LP = 0,
-    KARMA,
+// Frames committed since a consumer last fetched, oldest first.
+//
+// Slots are reserved for frameCount frames and overwritten in place, so the
+// arrays in a slot keep their storage while the FFT sizes and LP order stay
+// the same. A batch only allocates the first time each slot is filled.
+struct FrameBatch {
+    // Circular once it holds frameCount frames.
+    std::vector<AnalysisFrame> frames;
+    int first = 0;
+    int count = 0;
+    int frameCount = 0;
+
+    double maximumFrequency = 0;
+    FormantMethod formantMethod = KARMA;
+    // Predictor of the last frame, at lpcSampleRate.
+    LPC::Frame lpc = {0, Eigen::ArrayXd(), 0};
+    double lpcSampleRate = 0;
+
+    void append(const AnalysisFrame & frame, int frameCount);
+    void clear();
 };
 
 class Analyser {
@@ -57,6 +65,10 @@ public:
     void setWindowSpan(const std::chrono::duration<double> & windowSpan);
     void setPitchAlgorithm(enum PitchAlg);
     void setFormantMethod(enum FormantMethod);
+    void setSpectrumBins(int);
+    void setSpectrumAveraging(int);
+    void setSlidingSpectrum(bool);
+    void setExtraFftSizes(const std::vector<int> &);
 
     [[nodiscard]] double getSampleRate();
 
@@ -70,11 +82,15 @@ public:
     [[nodiscard]] const std::chrono::duration<double> & getWindowSpan();
     [[nodiscard]] PitchAlg getPitchAlgorithm();
     [[nodiscard]] FormantMethod getFormantMethod();
+    [[nodiscard]] int getSpectrumBins();
+    [[nodiscard]] int getSpectrumAveraging();
+    [[nodiscard]] bool getSlidingSpectrum();
+    [[nodiscard]] std::vector<int> getExtraFftSizes();
 
     [[nodiscard]] int getFrameCount();
 
-    [[nodiscard]] const SpecFrame & getSpectrumFrame(int iframe);
-    [[nodiscard]] const Formant::Frame & getFormantFrame(int iframe);
+    [[nodiscard]] const SpecFrame & getSpectrumFrame(int iframe, int resolution = 0);
+    [[nodiscard]] Formant::Frame getFormantFrame(int iframe);
     [[nodiscard]] double getPitchFrame(int iframe);
     [[nodiscard]] double getOqFrame(int iframe);
 
@@ -84,20 +100,14 @@ private:
 
     void _updateFrameCount();
     void _updateCaptureDuration();
-    void _initEkfState();
-    void _initResampler();
+
+    // Runs the latest planning task handed over, on its own thread.
+    void planLoop();
+    void schedulePlanning(std::function<void()> task);
 
     void mainLoop();
-    void update();
-    void applyWindow();
-    void analyseSpectrum();
-    void analysePitch();
-    void analyseOq();
-    void resampleAudio();
-    void applyPreEmphasis();
-    void analyseLp();
-    void analyseFormant();
-    void analyseFormantEkf();
+    bool update();
+    void commitFrame(const AnalysisFrame & frame);
     void trackFormants();
     void applySmoothingFilters();
 
@@ -105,11 +115,19 @@ private:
 
     AudioInterface * audioInterface;
 
-    ma_resampler resampler;
-
     // Parameters.
     std::mutex paramLock;
 
+    // FFT planning can take seconds without wisdom, so it runs neither on the
+    // GUI thread nor under paramLock. Only the newest pending task is kept.
+    std::thread planThread;
+    std::mutex planLock;
+    std::condition_variable planRequested;
+    std::function<void()> pendingPlan;
+    bool planStopping;
+
+    AnalysisEngine engine;
+
     std::chrono::duration<double, std::milli> frameLength;
     std::chrono::duration<double, std::milli> frameSpace;
     std::chrono::duration<double> windowSpan;
@@ -120,37 +138,41 @@ private:
     int nsamples;
 
     bool doAnalyse;
-    int nfft;
-    double maximumFrequency;
-    int lpOrder;
-    int cepOrder;
-
-    FormantMethod formantMethod;
-    PitchAlg pitchAlg;
 
-    // Intermediate variables for analysis.
-    Eigen::ArrayXd x, x_fft;
-    double fs;
-    LPC::Frame lpcFrame;
-    EKF::State ekfState;
+    // Captured audio for the current frame.
+    Eigen::ArrayXf x, x_fft;
 
-    Formant::Frames formantTrack;
-    std::deque<double> pitchTrack;
+    // Capture position at which the next frame ends. Frames are spaced by
+    // exactly one hop in the capture stream, whenever the analysis runs.
+    std::uint64_t nextFrameEnd;
+    // End of the last frame submitted, 0 if the next one does not follow it.
+    std::uint64_t lastFrameEnd;
+    // Set when the capture stream or the hop grid must be picked up afresh.
+    bool resyncCapture;
 
     // Results
-    SpecFrame lpcSpectrum;
-    std::deque<SpecFrame> spectra;
-    Formant::Frames smoothedFormants;
-    std::deque<double> smoothedPitch;
-    std::deque<double> oqTrack;
+    TrackStore tracks;
 
-    SpecFrame lastSpectrumFrame;
-    Formant::Frame lastFormantFrame;
-    double lastPitchFrame;
-    double lastOqFrame;
+    // Each reader of the tracks (such as the main window's refresh timer)
+    // owns a slot: the analysis publishes batches of new frames to it and
+    // the reader replays them into its own copy of the tracks.
+    struct FrameConsumer {
+        std::atomic<bool> active{false};
+        TripleBuffer<FrameBatch> batches;
 
-    bool lpFailed;
-    std::map<int, int> nbNewFrames;
+        TrackStore tracks;
+        double maximumFrequency = 0;
+        FormantMethod formantMethod = KARMA;
+        LPC::Frame lpc = {0, Eigen::ArrayXd(), 0};
+        double lpcSampleRate = 0;
+
+        int apply(const FrameBatch & batch);
+    };
+
+    static constexpr int MAX_CONSUMERS = 4;
+    std::array<FrameConsumer, MAX_CONSUMERS> consumers;
+
+    std::uint64_t lastOverrunCount;
 
     // Thread-related members
     std::thread thread;
@@ -159,23 +181,37 @@ private:
 
 public:
 
+    // Never blocks the analysis: the tracks passed to the callbacks are the
+    // consumer's own copy. Each `nb` below MAX_CONSUMERS must only be used
+    // from one thread.
     template<typename Func1, typename Func2, typename Func3, typename Func4>
     void callIfNewFrames(int nb, Func1 fn1, Func2 fn2, Func3 fn3, Func4 fn4)
     {
-        std::lock_guard<std::mutex> lock(mutex);
-        
-        if (nbNewFrames.find(nb) == nbNewFrames.end()) {
-            nbNewFrames[nb] = 0;
+        FrameConsumer & consumer = consumers.at(nb);
+
+        consumer.active.store(true, std::memory_order_relaxed);
+
+        int nbNewFrames = 0;
+
+        if (consumer.batches.fetch()) {
+            nbNewFrames = consumer.apply(consumer.batches.readBuffer());
+        }
+
+        if (consumer.tracks.size() == 0) {
+            // Nothing has been published to this consumer yet.
+            return;
         }
 
-        if (nbNewFrames[nb] > 0) {
-            fn1(frameCount, maximumFrequency, formantMethod, smoothedPitch, smoothedFormants);
-            fn2(frameCount, nbNewFrames[nb], maximumFrequency, spectra.cend() - 1 - nbNewFrames[nb], spectra.cend());
-            fn3(maximumFrequency, lpcSpectrum);
-            nbNewFrames[nb] = 0;
+        const int nframe = consumer.tracks.size();
+        const double maximumFrequency = consumer.maximumFrequency;
+
+        if (nbNewFrames > 0) {
+            fn1(nframe, maximumFrequency, consumer.formantMethod, consumer.tracks);
+            fn2(nframe, nbNewFrames, maximumFrequency, consumer.tracks);
+            fn3(maximumFrequency, consumer.lpcSampleRate, consumer.lpc);
         }
 
-        fn4(frameCount, maximumFrequency);
+        fn4(nframe, maximumFrequency);
     }
 
 };
@@ -2,118 +2,119 @@
 // Created by rika on 16/11/2019.
 //
 
-#ifdef __linux__
-#include <unistd.h>
-#elif _WIN32
-#include <windows.h>
-#endif
-
+#include <algorithm>
 #include <chrono>
 #include "Analyser.h"
-#include "../lib/Pitch/Pitch.h"
-#include "../lib/Signal/Filter.h"
-#include "../lib/Signal/Window.h"
+#include "../log/simpleQtLogger.h"
+#include "../log/Trace.h"
 
 using namespace Eigen;
 
+// Upper bound on a wait for audio, so that stopping the thread and devices
+// that stopped delivering are noticed.
+static constexpr std::chrono::milliseconds captureWaitTimeout(50);
+
+// Frames submitted per update when catching up, so that parameter changes
+// are not held back for the whole backlog.
+static constexpr int maxFramesPerUpdate = 16;
+
 void Analyser::mainLoop()
 {
-    using namespace std::chrono;
-
-    time_point t1 = steady_clock::now();
+    Trace::setThreadName("analysis");
 
     while (running) {
-        update();
-
-        time_point t2 = steady_clock::now();
-
-        auto dt = t2 - t1;
-        if (dt < frameSpace) {
-            long waitMicro = duration_cast<microseconds>(frameSpace - dt).count();
-
-#if (_XOPEN_SOURCE >= 500) && ! (_POSIX_C_SOURCE >= 200809L) \
-                   || /* Glibc since 2.19: */ _DEFAULT_SOURCE \
-                   || /* Glibc versions <= 2.19: */ _BSD_SOURCE \
-                   || /* Android platform */ defined(__ANDROID__)
-            usleep(waitMicro);
-#elif _WIN32
-            HANDLE timer; 
-            LARGE_INTEGER ft; 
-
-            ft.QuadPart = -(10 * waitMicro); // Convert to 100 nanosecond interval, negative value indicates relative time
-
-            timer = CreateWaitableTimer(nullptr, TRUE, nullptr); 
-            SetWaitableTimer(timer, &ft, 0, nullptr, nullptr, 0); 
-            WaitForSingleObject(timer, INFINITE); 
-            CloseHandle(timer); 
-#else
-#warning "Unknown platform, using unreliable sleep_for wait."
-            std::this_thread::sleep_for(duration_cast<microseconds>(frameSpace - dt));
-#endif
-        }
-        else {
-            t1 = t2;
+        // Sleep until the audio callback delivers the end of the next frame.
+        if (!update()) {
+            audioInterface->waitForCapture(nextFrameEnd, captureWaitTimeout);
         }
     }
 }
 
-void Analyser::update()
+bool Analyser::update()
 {
-    if (!doAnalyse) {
-        return;
-    }
+    TRACE_SCOPE("Analyser::update");
 
     // Param lock.
-    paramLock.lock();
+    std::lock_guard<std::mutex> paramGuard(paramLock);
     
     // Read captured audio.
-    audioLock.lock();
-    
-    x.setZero(frameSamples);
-    audioInterface->readBlock(x);
+    std::lock_guard<std::mutex> audioGuard(audioLock);
 
-    x_fft.setZero(fftSamples);
-    audioInterface->readBlock(x_fft);
-    
-    fs = audioInterface->getSampleRate();
-   
-    audioLock.unlock();
+    if (!doAnalyse) {
+        // Pick up from the live audio when the analysis resumes.
+        resyncCapture = true;
+        return false;
+    }
 
-    // Remove DC by subtraction of the mean.
-    x -= x.mean();
+    const double fs = audioInterface->getSampleRate();
+    const std::uint64_t hop = std::max<std::uint64_t>(1, frameSpace.count() / 1000.0 * fs);
+    const std::uint64_t position = audioInterface->getCapturePosition();
 
-    // Get a pitch estimate.
-    analysePitch();
-    
-    // Get an Oq estimate.
-    analyseOq();
-    
-    // Resample audio.
-    resampleAudio();
-    
-    // Apply windowing.
-    applyWindow();
-  
-    // Apply pre-emphasis.
-    applyPreEmphasis();
- 
-    // Perform LP analysis.
-    analyseLp();   
+    if (resyncCapture) {
+        // Start the hop grid at the first frame that is fully captured.
+        nextFrameEnd = std::max<std::uint64_t>(position, nsamples);
+        lastFrameEnd = 0;
+        resyncCapture = false;
+    }
+
+    // Frames whose samples were already overwritten, or discarded when the
+    // capture buffer grew, are skipped, not analysed as silence.
+    const std::uint64_t oldestFrameEnd = audioInterface->getCaptureOldestPosition() + nsamples;
+
+    if (nextFrameEnd < oldestFrameEnd) {
+        const std::uint64_t skipped = (oldestFrameEnd - nextFrameEnd + hop - 1) / hop;
+        nextFrameEnd += skipped * hop;
+        lastFrameEnd = 0;
+        LS_WARN("Skipped " << skipped << " frames whose captured audio was lost");
+    }
 
-    // Analyse spectrum.
-    analyseSpectrum();
+    engine.setSampleRate(fs);
 
-    // Perform formant analysis.
-    analyseFormant();
+    int submitted = 0;
+
+    while (nextFrameEnd <= position && submitted < maxFramesPerUpdate) {
+        x.resize(frameSamples);
+        x_fft.resize(fftSamples);
+
+        // The producer can still lap us while we copy.
+        const bool complete = audioInterface->readBlockAt(nextFrameEnd - frameSamples, x)
+                              & audioInterface->readBlockAt(nextFrameEnd - fftSamples, x_fft);
+
+        if (!complete) {
+            lastFrameEnd = 0;
+            nextFrameEnd += hop;
+            continue;
+        }
+
+        const int advance = lastFrameEnd > 0 ? nextFrameEnd - lastFrameEnd : 0;
+
+        // Results come back through commitFrame once the engine's workers are done.
+        engine.submit(x, x_fft, advance);
+
+        lastFrameEnd = nextFrameEnd;
+        nextFrameEnd += hop;
+        ++submitted;
+    }
+
+    // The capture buffer counts every read that lost samples because we fell behind.
+    const auto overruns = audioInterface->getCaptureOverrunCount();
+
+    if (overruns != lastOverrunCount) {
+        LS_WARN("Analysis fell behind audio capture (" << (overruns - lastOverrunCount) << " overruns)");
+        lastOverrunCount = overruns;
+    }
 
+    // More frames are ready if we stopped at the batch limit.
+    return nextFrameEnd <= position;
+}
+
+void Analyser::commitFrame(const AnalysisFrame & frame)
+{
     // Lock the tracks to prevent data race conditions.
-    mutex.lock();
+    std::lock_guard<std::mutex> lock(mutex);
     
     // Update the raw tracks.
-    pitchTrack.pop_front();
-    pitchTrack.push_back(lastPitchFrame);
-    formantTrack.pop_front();
-    formantTrack.push_back(lastFormantFrame);
+    tracks.push(frame);
 
     // Apply postprocessing formant track correction.
     /*if (formantMethod == LP) {
@@ -124,25 +125,79 @@ void Analyser::update()
         }
     }*/
     
-    spectra.pop_front();
-    spectra.push_back(lastSpectrumFrame);
-
-    oqTrack.pop_front();
-    oqTrack.push_back(lastOqFrame);
-
     // Smooth out the pitch and formant tracks.
     applySmoothingFilters();
 
-    // Set the has-new-frames flag.
-    for (auto & [k, v] : nbNewFrames) {
-        if (v < frameCount) {
-            v++;
+    // Hand the new frame to every consumer. A consumer that has not fetched
+    // its last batch yet gets this frame in the next one.
+    for (auto & consumer : consumers) {
+        if (!consumer.active.load(std::memory_order_relaxed)) {
+            continue;
+        }
+
+        FrameBatch & batch = consumer.batches.writeBuffer();
+        batch.append(frame, frameCount);
+        batch.maximumFrequency = engine.getMaximumFrequency();
+        batch.formantMethod = engine.getFormantMethod();
+        batch.lpc = frame.lpc;
+        batch.lpcSampleRate = frame.lpcSpectrum.fs;
+
+        if (consumer.batches.publish()) {
+            consumer.batches.writeBuffer().clear();
+        }
+    }
+}
+
+void FrameBatch::append(const AnalysisFrame & frame, int _frameCount)
+{
+    if (frameCount != _frameCount) {
+        // The consumer resizes its tracks when it sees the new count.
+        frameCount = _frameCount;
+        frames.reserve(std::max(frameCount, 0));
+        clear();
+    }
+
+    if (frameCount <= 0) {
+        return;
+    }
+
+    if (count < frameCount) {
+        const int i = (first + count) % frameCount;
+        if (i == int(frames.size())) {
+            frames.push_back(frame);
+        }
+        else {
+            frames[i] = frame;
         }
+        count++;
+    }
+    else {
+        // Drop the oldest frame, the consumer could not display it anyway.
+        frames[first] = frame;
+        first = (first + 1) % frameCount;
+    }
+}
+
+void FrameBatch::clear()
+{
+    first = 0;
+    count = 0;
+}
+
+int Analyser::FrameConsumer::apply(const FrameBatch & batch)
+{
+    if (tracks.size() != batch.frameCount) {
+        tracks.resize(batch.frameCount);
+    }
+
+    for (int i = 0; i < batch.count; ++i) {
+        tracks.push(batch.frames[(batch.first + i) % batch.frameCount]);
     }
 
-    // Unlock the tracks.
-    mutex.unlock();
+    maximumFrequency = batch.maximumFrequency;
+    formantMethod = batch.formantMethod;
+    lpc = batch.lpc;
+    lpcSampleRate = batch.lpcSampleRate;
 
-    // Unlock the parameters.
-    paramLock.unlock();
+    return batch.count;
 }
@@ -0,0 +1,597 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include <cmath>
+#include "AnalysisEngine.h"
+#include "../Exceptions.h"
+#include "../log/Trace.h"
+#include "FFT/FFT.h"
+#include "Signal/Autocorrelation.h"
+
+using namespace Eigen;
+
+const Formant::Frame AnalysisEngine::defaultFrame = {
+    .nFormants = 5,
+    .formant = {{550, 60}, {1650, 60}, {2750, 60}, {3850, 60}, {4950, 60}},
+    .intensity = 1.0,
+};
+
+const std::vector<AnalysisEngine::Stage> AnalysisEngine::stageInputs[NUM_STAGES] = {
+    /* StagePitch */       {},
+    /* StageOq */          {StagePitch},
+    /* StageResample */    {},
+    /* StageWindow */      {StageResample},
+    /* StageLp */          {StageWindow},
+    /* StageSpectrum */    {},
+    /* StageLpcSpectrum */ {StageLp},
+    /* StageFormant */     {StageLp, StagePitch},
+    /* StageCommit */      {StageOq, StageSpectrum, StageLpcSpectrum, StageFormant},
+};
+
+const bool AnalysisEngine::stageCarriesState[NUM_STAGES] = {
+    /* StagePitch */       true,
+    /* StageOq */          false,
+    /* StageResample */    true,
+    /* StageWindow */      false,
+    /* StageLp */          false,
+    /* StageSpectrum */    false,
+    /* StageLpcSpectrum */ false,
+    /* StageFormant */     true,
+    /* StageCommit */      true,
+};
+
+const char * const AnalysisEngine::stageNames[NUM_STAGES] = {
+    /* StagePitch */       "AnalysisEngine::analysePitch",
+    /* StageOq */          "AnalysisEngine::analyseOq",
+    /* StageResample */    "AnalysisEngine::resampleAudio",
+    /* StageWindow */      "AnalysisEngine::applyWindow",
+    /* StageLp */          "AnalysisEngine::analyseLp",
+    /* StageSpectrum */    "AnalysisEngine::analyseSpectrum",
+    /* StageLpcSpectrum */ "AnalysisEngine::analyseLpcSpectrum",
+    /* StageFormant */     "AnalysisEngine::analyseFormant",
+    /* StageCommit */      "AnalysisEngine::commitFrame",
+};
+
+AnalysisEngine::AnalysisEngine(double sampleRate, int numWorkers)
+    : sampleRate(sampleRate),
+      nfft(512),
+      maximumFrequency(4700),
+      lpOrder(12),
+      cepOrder(15),
+      spectrumBins(0),
+      spectrumAveraging(1),
+      slidingSpectrum(false),
+      spectrumEnabled(true),
+      formantMethod(KARMA),
+      pitchAlg(Wavelet),
+      stopping(false),
+      nextIndex(0),
+      committedCount(0),
+      spectrumHistoryCount(0),
+      spectrumHistoryNext(0)
+{
+    _initResampler();
+    _initEkfState();
+
+    last.spectrum = {sampleRate, 0, 0, Eigen::ArrayXd()};
+    last.lpcSpectrum = {sampleRate, 0, 0, Eigen::ArrayXd()};
+    last.formants = defaultFrame;
+    last.pitch = 0;
+    last.oq = 0;
+
+    for (auto & ctx : frames) {
+        ctx.active = false;
+    }
+
+    readyQueue.reserve(FRAMES_IN_FLIGHT * NUM_STAGES);
+
+    // There are at most three independent branches in a frame.
+    if (numWorkers <= 0) {
+        numWorkers = std::clamp<int>(std::thread::hardware_concurrency(), 1, 3);
+    }
+    for (int i = 0; i < numWorkers; ++i) {
+        workers.emplace_back(&AnalysisEngine::workerLoop, this);
+    }
+}
+
+AnalysisEngine::~AnalysisEngine()
+{
+    wait();
+
+    {
+        std::lock_guard<std::mutex> lock(schedLock);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (auto & worker : workers) {
+        worker.join();
+    }
+
+    ma_resampler_uninit(&resampler);
+}
+
+void AnalysisEngine::setSampleRate(double _sampleRate) {
+    if (_sampleRate == sampleRate) {
+        return;
+    }
+
+    wait();
+
+    sampleRate = _sampleRate;
+
+    if (ma_resampler_set_rate(&resampler, sampleRate, 2 * maximumFrequency) != MA_SUCCESS) {
+        throw AudioException("Unable to change resampler input rate");
+    }
+
+    _initSpectrum();
+}
+
+double AnalysisEngine::getSampleRate() const {
+    return sampleRate;
+}
+
+void AnalysisEngine::setFftSize(int _nfft) {
+    wait();
+    nfft = _nfft;
+    _initSpectrum();
+}
+
+int AnalysisEngine::getFftSize() const {
+    return nfft;
+}
+
+void AnalysisEngine::setLinearPredictionOrder(int _lpOrder) {
+    wait();
+    lpOrder = std::clamp(_lpOrder, 5, 22);
+}
+
+int AnalysisEngine::getLinearPredictionOrder() const {
+    return lpOrder;
+}
+
+void AnalysisEngine::setMaximumFrequency(double _maximumFrequency) {
+    wait();
+
+    maximumFrequency = std::clamp(_maximumFrequency, 2500.0, 7000.0);
+
+    if (ma_resampler_set_rate(&resampler, sampleRate, 2 * maximumFrequency) != MA_SUCCESS) {
+        throw AudioException("Unable to change resampler output rate");
+    }
+
+    _initSpectrum();
+}
+
+double AnalysisEngine::getMaximumFrequency() const {
+    return maximumFrequency;
+}
+
+void AnalysisEngine::setCepstralOrder(int _cepOrder) {
+    wait();
+
+    cepOrder = std::clamp(_cepOrder, 7, 25);
+
+    _initEkfState();
+}
+
+int AnalysisEngine::getCepstralOrder() const {
+    return cepOrder;
+}
+
+void AnalysisEngine::setPitchAlgorithm(enum PitchAlg _pitchAlg) {
+    wait();
+    pitchAlg = _pitchAlg;
+    // The tracker only saw the frames it estimated.
+    if (pitchEstimators[pitchAlg]) {
+        pitchEstimators[pitchAlg]->reset();
+    }
+}
+
+PitchAlg AnalysisEngine::getPitchAlgorithm() const {
+    return pitchAlg;
+}
+
+void AnalysisEngine::setFormantMethod(enum FormantMethod _method) {
+    wait();
+    formantMethod = _method;
+}
+
+FormantMethod AnalysisEngine::getFormantMethod() const {
+    return formantMethod;
+}
+
+void AnalysisEngine::setSpectrumBins(int _spectrumBins) {
+    wait();
+    spectrumBins = std::max(_spectrumBins, 0);
+    _initSpectrum();
+}
+
+int AnalysisEngine::getSpectrumBins() const {
+    return spectrumBins;
+}
+
+void AnalysisEngine::setSpectrumAveraging(int _spectrumAveraging) {
+    wait();
+    spectrumAveraging = std::clamp(_spectrumAveraging, 1, 16);
+    spectrumHistory.resize(spectrumAveraging);
+    spectrumHistoryNext = 0;
+    _initSpectrum();
+}
+
+int AnalysisEngine::getSpectrumAveraging() const {
+    return spectrumAveraging;
+}
+
+void AnalysisEngine::setSlidingSpectrum(bool _slidingSpectrum) {
+    wait();
+    slidingSpectrum = _slidingSpectrum;
+    _initSpectrum();
+}
+
+bool AnalysisEngine::getSlidingSpectrum() const {
+    return slidingSpectrum;
+}
+
+void AnalysisEngine::setExtraFftSizes(const std::vector<int> & _extraFftSizes) {
+    wait();
+
+    extraFftSizes.clear();
+    for (int size : _extraFftSizes) {
+        if (size > 0 && extraFftSizes.size() < MAX_EXTRA_SPECTRA) {
+            extraFftSizes.push_back(size);
+        }
+    }
+}
+
+const std::vector<int> & AnalysisEngine::getExtraFftSizes() const {
+    return extraFftSizes;
+}
+
+void AnalysisEngine::setSpectrumEnabled(bool _spectrumEnabled) {
+    wait();
+    spectrumEnabled = _spectrumEnabled;
+    _initSpectrum();
+}
+
+bool AnalysisEngine::getSpectrumEnabled() const {
+    return spectrumEnabled;
+}
+
+int AnalysisEngine::getCaptureFftSize() const {
+    if (!spectrumEnabled) {
+        return 0;
+    }
+    int size = nfft;
+    for (int extra : extraFftSizes) {
+        size = std::max(size, extra);
+    }
+    return size;
+}
+
+void AnalysisEngine::setFrameCallback(FrameCallback callback) {
+    wait();
+    frameCallback = std::move(callback);
+}
+
+void AnalysisEngine::submit(const ArrayXd & frame, const ArrayXd & fftFrame, int advance)
+{
+    submit(ArrayXf(frame.cast<float>()), ArrayXf(fftFrame.cast<float>()), advance);
+}
+
+void AnalysisEngine::submit(const ArrayXf & frame, const ArrayXf & fftFrame, int advance)
+{
+    std::unique_lock<std::mutex> lock(schedLock);
+
+    frameCommitted.wait(lock, [this] { return nextIndex - committedCount < FRAMES_IN_FLIGHT; });
+
+    const int slot = nextIndex % FRAMES_IN_FLIGHT;
+    FrameContext & ctx = frames[slot];
+
+    ctx.index = nextIndex++;
+    ctx.nfft = nfft;
+    ctx.extraFftSizes = extraFftSizes;
+    ctx.lpOrder = lpOrder;
+    ctx.cepOrder = cepOrder;
+    ctx.pitchAlg = pitchAlg;
+    ctx.formantMethod = formantMethod;
+    ctx.sampleRate = sampleRate;
+    ctx.resampledRate = resampler.config.sampleRateOut;
+    ctx.advance = advance;
+
+    // Remove DC by subtraction of the mean.
+    ctx.xf = frame - frame.mean();
+    ctx.x = ctx.xf.cast<double>();
+    ctx.x_fft = fftFrame;
+
+    ctx.done.fill(false);
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        ctx.pending[s] = countDependencies(ctx, Stage(s));
+    }
+    ctx.active = true;
+
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        if (ctx.pending[s] == 0) {
+            scheduleStage(slot, Stage(s));
+        }
+    }
+}
+
+void AnalysisEngine::wait()
+{
+    std::unique_lock<std::mutex> lock(schedLock);
+    frameCommitted.wait(lock, [this] { return committedCount == nextIndex; });
+}
+
+void AnalysisEngine::process(const ArrayXf & frame, const ArrayXf & fftFrame)
+{
+    submit(frame, fftFrame);
+    wait();
+}
+
+void AnalysisEngine::process(const ArrayXd & frame, const ArrayXd & fftFrame)
+{
+    submit(frame, fftFrame);
+    wait();
+}
+
+void AnalysisEngine::prepareTransforms(int frameSamples) const
+{
+    transformPreparation(frameSamples)();
+}
+
+std::function<void()> AnalysisEngine::transformPreparation(int frameSamples) const
+{
+    const int zoomSize = zoomSpectrum ? zoomSpectrum->fftSize() : 0;
+    const bool sliding = slidingDft != nullptr;
+    const bool spectrum = spectrumEnabled;
+
+    return [spectrum, zoomSize, sliding, nfft = nfft, extraFftSizes = extraFftSizes, frameSamples]() {
+        // Spectrum.
+        if (spectrum) {
+            if (zoomSize > 0) {
+                fft_prepare<CFFT, float>(zoomSize);
+                fft_prepare<ICFFT, float>(zoomSize);
+            }
+            else if (sliding) {
+                fft_prepare<RCFFT>(nfft);
+            }
+            else {
+                fft_prepare<RCFFT, float>(nfft);
+            }
+            for (int size : extraFftSizes) {
+                fft_prepare<RCFFT, float>(size);
+            }
+        }
+
+        // Autocorrelation, for the McLeod pitch estimator.
+        const int nacorr = Autocorrelation::fastSize(2 * frameSamples);
+        fft_prepare<RCFFT>(nacorr);
+        fft_prepare<CRFFT>(nacorr);
+
+        // Cross-correlation, for the YIN pitch estimator.
+        const int nxcorr = Autocorrelation::fastSize(frameSamples);
+        fft_prepare<RCFFT>(nxcorr);
+        fft_prepare<CRFFT>(nxcorr);
+    };
+}
+
+const SpecFrame & AnalysisEngine::getSpectrumFrame() const {
+    return last.spectrum;
+}
+
+const SpecFrame & AnalysisEngine::getLpcSpectrum() const {
+    return last.lpcSpectrum;
+}
+
+const Formant::Frame & AnalysisEngine::getFormantFrame() const {
+    return last.formants;
+}
+
+double AnalysisEngine::getPitchFrame() const {
+    return last.pitch;
+}
+
+double AnalysisEngine::getOqFrame() const {
+    return last.oq;
+}
+
+void AnalysisEngine::workerLoop()
+{
+    Trace::setThreadName("analysis worker");
+
+    std::unique_lock<std::mutex> lock(schedLock);
+
+    while (true) {
+        workAvailable.wait(lock, [this] { return stopping || !readyQueue.empty(); });
+
+        if (readyQueue.empty()) {
+            return;
+        }
+
+        // Oldest frame first, so that a frame's latency stays close to its critical path.
+        auto it = std::min_element(readyQueue.begin(), readyQueue.end(),
+                [this](const Task & a, const Task & b) {
+                    const auto ia = frames[a.slot].index, ib = frames[b.slot].index;
+                    return ia < ib || (ia == ib && a.stage < b.stage);
+                });
+        const Task task = *it;
+        *it = readyQueue.back();
+        readyQueue.pop_back();
+
+        lock.unlock();
+        runStage(frames[task.slot], task.stage);
+        lock.lock();
+
+        completeStage(task.slot, task.stage);
+    }
+}
+
+void AnalysisEngine::runStage(FrameContext & ctx, Stage stage)
+{
+    TRACE_SCOPE(stageNames[stage]);
+
+    switch (stage) {
+        case StagePitch:
+            analysePitch(ctx);
+            break;
+        case StageOq:
+            analyseOq(ctx);
+            break;
+        case StageResample:
+            resampleAudio(ctx);
+            break;
+        case StageWindow:
+            applyWindow(ctx);
+            applyPreEmphasis(ctx);
+            break;
+        case StageLp:
+            analyseLp(ctx);
+            break;
+        case StageSpectrum:
+            analyseSpectrum(ctx);
+            break;
+        case StageLpcSpectrum:
+            analyseLpcSpectrum(ctx);
+            break;
+        case StageFormant:
+            analyseFormant(ctx);
+            break;
+        case StageCommit:
+            commitFrame(ctx);
+            break;
+        default:
+            break;
+    }
+}
+
+// Called with schedLock held.
+void AnalysisEngine::scheduleStage(int slot, Stage stage)
+{
+    readyQueue.push_back({slot, stage});
+    workAvailable.notify_one();
+}
+
+// Called with schedLock held.
+void AnalysisEngine::completeStage(int slot, Stage stage)
+{
+    FrameContext & ctx = frames[slot];
+
+    ctx.done[stage] = true;
+
+    for (int s = 0; s < NUM_STAGES; ++s) {
+        for (Stage input : stageInputs[s]) {
+            if (input == stage && --ctx.pending[s] == 0) {
+                scheduleStage(slot, Stage(s));
+            }
+        }
+    }
+
+    if (carriesState(stage)) {
+        FrameContext * next = findFrame(ctx.index + 1);
+        if (next != nullptr && --next->pending[stage] == 0) {
+            scheduleStage(next - frames.data(), stage);
+        }
+    }
+
+    if (stage == StageCommit) {
+        ctx.active = false;
+        committedCount++;
+        frameCommitted.notify_all();
+    }
+}
+
+// Called with schedLock held.
+int AnalysisEngine::countDependencies(const FrameContext & ctx, Stage stage) const
+{
+    int count = stageInputs[stage].size();
+
+    if (carriesState(stage) && ctx.index > 0) {
+        const FrameContext & prev = frames[(ctx.index - 1) % FRAMES_IN_FLIGHT];
+        if (prev.active && prev.index == ctx.index - 1 && !prev.done[stage]) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+bool AnalysisEngine::carriesState(Stage stage) const
+{
+    return stageCarriesState[stage] || (stage == StageSpectrum && slidingDft);
+}
+
+AnalysisEngine::FrameContext * AnalysisEngine::findFrame(std::uint64_t index)
+{
+    FrameContext & ctx = frames[index % FRAMES_IN_FLIGHT];
+    return (ctx.active && ctx.index == index) ? &ctx : nullptr;
+}
+
+void AnalysisEngine::commitFrame(FrameContext & ctx)
+{
+    if (spectrumEnabled && spectrumAveraging > 1) {
+        averageSpectrum(ctx.result.spectrum);
+    }
+
+    // Commits are serialised, so `last` is only ever written here.
+    last = ctx.result;
+
+    if (frameCallback) {
+        frameCallback(ctx.result);
+    }
+}
+
+void AnalysisEngine::_initEkfState()
+{
+    int numF = 3;
+
+    VectorXd x0(2 * numF);
+    x0.setZero();
+
+    for (int k = 0; k < numF; ++k) {
+        x0(k) = 550 + 600 * k;
+        x0(numF + k) = 90 + 20 * k;
+    }
+
+    ekfState.cepOrder = this->cepOrder;
+
+    EKF::init(ekfState, x0);
+}
+
+void AnalysisEngine::_initSpectrum()
+{
+    // The bins change, so the spectra to average with are stale.
+    spectrumHistoryCount = 0;
+
+    if (spectrumBins > 0) {
+        zoomSpectrum = std::make_unique<ChirpZ>(nfft, spectrumBins, 0.0, maximumFrequency / spectrumBins, sampleRate);
+    }
+    else {
+        zoomSpectrum.reset();
+    }
+
+    if (spectrumEnabled && slidingSpectrum && !zoomSpectrum) {
+        // Up to the maximum frequency, and recomputed about once a second.
+        const int bins = std::ceil(maximumFrequency * nfft / sampleRate) + 1;
+        slidingDft = std::make_unique<SlidingDFT>(nfft, bins, std::max<int>(nfft, sampleRate));
+    }
+    else {
+        slidingDft.reset();
+    }
+}
+
+void AnalysisEngine::_initResampler()
+{
+    ma_resampler_config config = ma_resampler_config_init(
+            ma_format_f32,
+            1,
+            sampleRate,
+            2 * maximumFrequency,
+            ma_resample_algorithm_speex);
+    config.speex.quality = 10;
+
+    if (ma_resampler_init(&config, &resampler) != MA_SUCCESS) {
+        throw AudioException("Unable to initialise resampler");
+    }
+}
@@ -0,0 +1,328 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_ANALYSISENGINE_H
+#define SPEECH_ANALYSIS_ANALYSISENGINE_H
+
+#include "../audio/miniaudio.h"
+#include <Eigen/Core>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../lib/FFT/ChirpZ.h"
+#include "../lib/FFT/SlidingDFT.h"
+#include "../lib/Formant/Formant.h"
+#include "../lib/Formant/EKF/EKF.h"
+#include "../lib/Pitch/DynamicWavelet.h"
+
+// Power spectrum of nfft samples at fs. Bin i is at the frequency
+// i * binWidth, and there are spec.size() bins.
+struct SpecFrame {
+    double fs;
+    int nfft;
+    double binWidth;
+    Eigen::ArrayXd spec;
+};
+
+enum PitchAlg {
+    Wavelet = 0,
+    McLeod,
+    YIN,
+    AMDF,
+    // YIN in the time domain, stopping at the first dip.
+    FastYIN,
+};
+
+constexpr int NUM_PITCH_ALGS = FastYIN + 1;
+
+enum FormantMethod {
+    LP = 0,
+    KARMA,
+};
+
+struct AnalysisFrame {
+    SpecFrame spectrum;
+    // The predictor at lpcSpectrum.fs, the resampled rate. The envelope is
+    // not evaluated here (spec is empty): the spectrum display evaluates it
+    // from `lpc` on its own frequency grid.
+    SpecFrame lpcSpectrum;
+    LPC::Frame lpc;
+    // Spectra at the extra FFT sizes, in the order they were set.
+    std::vector<SpecFrame> extraSpectra;
+    Formant::Frame formants;
+    double pitch;
+    double oq;
+};
+
+// Per-frame analysis pipeline, independent of Qt and of the audio devices.
+// It is driven either by the live Analyser or by the offline file analyser.
+//
+// Each frame is split into stages that run on a small worker pool as soon as
+// their inputs are ready. Stages that carry state from one frame to the next
+// also wait for the same stage of the previous frame, so up to
+// FRAMES_IN_FLIGHT frames overlap and are still committed in order.
+//
+//   Stage         Needs                                 Carries state
+//   Pitch                                               yes (estimators)
+//   Oq            Pitch
+//   Resample                                            yes (resampler)
+//   Window        Resample
+//   Lp            Window
+//   Spectrum                                            if sliding (DFT bins)
+//   LpcSpectrum   Lp
+//   Formant       Lp, Pitch                             yes (Kalman filter)
+//   Commit        Oq, Spectrum, LpcSpectrum, Formant    yes (frame order)
+//
+// The spectrum stage can also compute plain spectra at other FFT sizes from
+// the same capture, for a wideband and a narrowband view of the same hop.
+//
+// The pitch stage keeps one estimator per algorithm, made for the frame
+// length and sample rate it first sees, and remade only when they change.
+
+class AnalysisEngine {
+public:
+    static constexpr int FRAMES_IN_FLIGHT = 3;
+    static constexpr int MAX_EXTRA_SPECTRA = 2;
+
+    using FrameCallback = std::function<void(const AnalysisFrame &)>;
+
+    explicit AnalysisEngine(double sampleRate, int numWorkers = -1);
+    ~AnalysisEngine();
+
+    AnalysisEngine(const AnalysisEngine &) = delete;
+    AnalysisEngine & operator=(const AnalysisEngine &) = delete;
+
+    // Setters wait for the frames in flight to be committed.
+    void setSampleRate(double);
+    void setFftSize(int);
+    void setLinearPredictionOrder(int);
+    void setMaximumFrequency(double);
+    void setCepstralOrder(int);
+    void setPitchAlgorithm(enum PitchAlg);
+    void setFormantMethod(enum FormantMethod);
+
+    // With 0 (the default), the spectrum has getFftSize() / 2 + 1 bins across
+    // the whole band. Otherwise the same getFftSize() samples are evaluated
+    // at this many bins from 0 to getMaximumFrequency() with a chirp-z
+    // transform.
+    void setSpectrumBins(int);
+
+    // Averages the power spectrum over this many consecutive frames
+    // (Welch's method over the hops), 1 for none.
+    void setSpectrumAveraging(int);
+
+    // Updates the full-band spectrum with a sliding DFT over the bins up to
+    // getMaximumFrequency(), from the samples that are new since the
+    // previous frame. Worth it for hops much shorter than getFftSize().
+    // Ignored while setSpectrumBins() is in effect.
+    void setSlidingSpectrum(bool);
+
+    // Also computes full-band spectra at these FFT sizes, up to
+    // MAX_EXTRA_SPECTRA of them, into AnalysisFrame::extraSpectra. They
+    // share the capture and its pre-emphasis with the main spectrum, but
+    // are neither zoomed, slid nor averaged.
+    void setExtraFftSizes(const std::vector<int> &);
+
+    // Off skips the spectrum stage: frames carry empty spectra and fftFrame
+    // may be empty. For callers that take their spectra some other way.
+    void setSpectrumEnabled(bool);
+
+    [[nodiscard]] double getSampleRate() const;
+    [[nodiscard]] int getFftSize() const;
+    [[nodiscard]] int getLinearPredictionOrder() const;
+    [[nodiscard]] double getMaximumFrequency() const;
+    [[nodiscard]] int getCepstralOrder() const;
+    [[nodiscard]] PitchAlg getPitchAlgorithm() const;
+    [[nodiscard]] FormantMethod getFormantMethod() const;
+    [[nodiscard]] int getSpectrumBins() const;
+    [[nodiscard]] int getSpectrumAveraging() const;
+    [[nodiscard]] bool getSlidingSpectrum() const;
+    [[nodiscard]] const std::vector<int> & getExtraFftSizes() const;
+    [[nodiscard]] bool getSpectrumEnabled() const;
+
+    // Samples that fftFrame must hold: the largest of the FFT sizes, or 0
+    // with the spectrum off.
+    [[nodiscard]] int getCaptureFftSize() const;
+
+    // Called from a worker thread, in frame order, when a frame is committed.
+    void setFrameCallback(FrameCallback callback);
+
+    // Queues one frame. `frame` holds the analysis frame and `fftFrame` the
+    // last getCaptureFftSize() samples, both at getSampleRate(). Each
+    // spectrum is taken from the end of fftFrame. Blocks only while
+    // FRAMES_IN_FLIGHT frames are already being analysed.
+    //
+    // `advance` is how far fftFrame moved on in the stream since the
+    // previous frame, or 0 if unknown. Only the sliding spectrum needs it.
+    void submit(const Eigen::ArrayXf & frame, const Eigen::ArrayXf & fftFrame, int advance = 0);
+    void submit(const Eigen::ArrayXd & frame, const Eigen::ArrayXd & fftFrame, int advance = 0);
+
+    // Blocks until every submitted frame has been committed.
+    void wait();
+
+    // Submits one frame and waits for it.
+    void process(const Eigen::ArrayXf & frame, const Eigen::ArrayXf & fftFrame);
+    void process(const Eigen::ArrayXd & frame, const Eigen::ArrayXd & fftFrame);
+
+    // Plans the transforms that frames of `frameSamples` samples need with the
+    // current settings, so that measured FFT planning does not hold up the
+    // first frames.
+    void prepareTransforms(int frameSamples) const;
+
+    // The same planning as a task that holds its own copy of the sizes, so
+    // that it can run on another thread while the settings change.
+    [[nodiscard]] std::function<void()> transformPreparation(int frameSamples) const;
+
+    // Results of the last committed frame, stable after wait().
+    [[nodiscard]] const SpecFrame & getSpectrumFrame() const;
+    [[nodiscard]] const SpecFrame & getLpcSpectrum() const;
+    [[nodiscard]] const Formant::Frame & getFormantFrame() const;
+    [[nodiscard]] double getPitchFrame() const;
+    [[nodiscard]] double getOqFrame() const;
+
+    static const Formant::Frame defaultFrame;
+
+private:
+    enum Stage {
+        StagePitch = 0,
+        StageOq,
+        StageResample,
+        StageWindow,
+        StageLp,
+        StageSpectrum,
+        StageLpcSpectrum,
+        StageFormant,
+        StageCommit,
+        NUM_STAGES,
+    };
+
+    struct FrameContext {
+        std::uint64_t index;
+        bool active;
+
+        // Parameters at submission time.
+        int nfft;
+        std::vector<int> extraFftSizes;
+        int lpOrder;
+        int cepOrder;
+        PitchAlg pitchAlg;
+        FormantMethod formantMethod;
+        double sampleRate;
+        double resampledRate;
+        int advance;
+
+        // Intermediate variables for analysis. The signal path up to the LP
+        // coefficients and the spectrum is in single precision; pitch and
+        // open quotient estimation take a double copy of the frame.
+        Eigen::ArrayXf xf, x_fft, xr;
+        Eigen::ArrayXd x;
+        Eigen::ArrayXf window, fftWindow;
+        std::vector<Eigen::ArrayXf> extraFftWindows;
+        Eigen::ArrayXcf zoomBins;
+        LPC::Frame lpcFrame;
+        Eigen::VectorXd cepstrum;
+        bool lpFailed;
+
+        AnalysisFrame result;
+
+        std::array<int, NUM_STAGES> pending;
+        std::array<bool, NUM_STAGES> done;
+    };
+
+    // Stages each stage waits for within the same frame, and whether it
+    // also waits for the same stage of the previous frame.
+    static const std::vector<Stage> stageInputs[NUM_STAGES];
+    static const bool stageCarriesState[NUM_STAGES];
+    // Names of the stages in performance traces.
+    static const char * const stageNames[NUM_STAGES];
+
+    struct Task {
+        int slot;
+        Stage stage;
+    };
+
+    void _initEkfState();
+    void _initResampler();
+    void _initSpectrum();
+
+    void workerLoop();
+    void runStage(FrameContext & ctx, Stage stage);
+    void scheduleStage(int slot, Stage stage);
+    void completeStage(int slot, Stage stage);
+    int countDependencies(const FrameContext & ctx, Stage stage) const;
+    bool carriesState(Stage stage) const;
+    FrameContext * findFrame(std::uint64_t index);
+
+    void analysePitch(FrameContext & ctx);
+    Pitch::Estimator & pitchEstimator(PitchAlg alg, double fs, int frameLength);
+    void analyseOq(FrameContext & ctx);
+    void resampleAudio(FrameContext & ctx);
+    void applyWindow(FrameContext & ctx);
+    void applyPreEmphasis(FrameContext & ctx);
+    void applySpectrumPreEmphasis(FrameContext & ctx);
+    void analyseLp(FrameContext & ctx);
+    void analyseSpectrum(FrameContext & ctx);
+    void analyseExtraSpectra(FrameContext & ctx);
+    void averageSpectrum(SpecFrame & spectrum);
+    void analyseLpcSpectrum(FrameContext & ctx);
+    void analyseFormant(FrameContext & ctx);
+    void analyseFormantEkf(FrameContext & ctx);
+    void commitFrame(FrameContext & ctx);
+
+    ma_resampler resampler;
+
+    // Parameters.
+    double sampleRate;
+    int nfft;
+    double maximumFrequency;
+    int lpOrder;
+    int cepOrder;
+    int spectrumBins;
+    int spectrumAveraging;
+    bool slidingSpectrum;
+    std::vector<int> extraFftSizes;
+    bool spectrumEnabled;
+
+    // Set when spectrumBins > 0. Only replaced while no frame is in flight.
+    std::unique_ptr<ChirpZ> zoomSpectrum;
+    // Set when slidingSpectrum is in effect. Updated by one frame at a time.
+    std::unique_ptr<SlidingDFT> slidingDft;
+
+    FormantMethod formantMethod;
+    PitchAlg pitchAlg;
+
+    // State carried across frames.
+    EKF::State ekfState;
+    std::array<std::unique_ptr<Pitch::Estimator>, NUM_PITCH_ALGS> pitchEstimators;
+
+    // Scheduling.
+    std::mutex schedLock;
+    std::condition_variable workAvailable;
+    std::condition_variable frameCommitted;
+    std::vector<Task> readyQueue;
+    std::vector<std::thread> workers;
+    bool stopping;
+
+    std::array<FrameContext, FRAMES_IN_FLIGHT> frames;
+    std::uint64_t nextIndex;
+    std::uint64_t committedCount;
+
+    FrameCallback frameCallback;
+
+    // Power spectra of the last frames, for averaging at commit. Only
+    // spectrumHistoryCount of them hold the current bins.
+    std::vector<Eigen::ArrayXd> spectrumHistory;
+    int spectrumHistoryCount;
+    int spectrumHistoryNext;
+
+    // Results of the last committed frame.
+    AnalysisFrame last;
+};
+
+#endif //SPEECH_ANALYSIS_ANALYSISENGINE_H
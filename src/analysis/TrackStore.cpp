@@ -0,0 +1,174 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include "TrackStore.h"
+
+using namespace Eigen;
+
+const SpecFrame TrackStore::defaultSpectrum = {
+    .fs = 16000,
+    .nfft = 512,
+    .binWidth = 16000.0 / 512,
+    .spec = ArrayXd::Zero(257),
+};
+
+const SpecFrame TrackStore::emptySpectrum = {
+    .fs = 16000,
+    .nfft = 0,
+    .binWidth = 0,
+    .spec = ArrayXd(),
+};
+
+TrackStore::TrackStore()
+    : count(0),
+      head(0),
+      frequencies(MAX_FORMANTS),
+      bandwidths(MAX_FORMANTS),
+      spectrumSlots(NUM_RESOLUTIONS)
+{
+}
+
+void TrackStore::resize(int frameCount)
+{
+    frameCount = std::max(frameCount, 0);
+
+    if (frameCount == count) {
+        return;
+    }
+
+    // Unroll the ring so that the newest frames end up at the back.
+    const int keep = std::min(count, frameCount);
+    const int pad = frameCount - keep;
+
+    auto unroll = [&](auto & vec, const auto & fill) {
+        std::remove_reference_t<decltype(vec)> out;
+        out.reserve(frameCount);
+        out.resize(pad, fill);
+        for (int i = count - keep; i < count; ++i) {
+            out.push_back(std::move(vec[slot(i)]));
+        }
+        vec = std::move(out);
+    };
+
+    const Formant::Frame & defaultFrame = AnalysisEngine::defaultFrame;
+
+    unroll(pitches, 0.0);
+    unroll(oqs, 0.0);
+    unroll(formantCounts, defaultFrame.nFormants);
+    for (int k = 0; k < MAX_FORMANTS; ++k) {
+        const bool inDefault = k < defaultFrame.nFormants;
+        unroll(frequencies[k], inDefault ? defaultFrame.formant[k].frequency : 0.0);
+        unroll(bandwidths[k], inDefault ? defaultFrame.formant[k].bandwidth : 0.0);
+    }
+    unroll(spectrumSlots[0], defaultSpectrum);
+    for (int r = 1; r < NUM_RESOLUTIONS; ++r) {
+        unroll(spectrumSlots[r], emptySpectrum);
+    }
+
+    count = frameCount;
+    head = 0;
+}
+
+void TrackStore::push(const AnalysisFrame & frame)
+{
+    if (count == 0) {
+        return;
+    }
+
+    pitches[head] = frame.pitch;
+    oqs[head] = frame.oq;
+    writeFormants(head, frame.formants);
+
+    writeSpectrum(spectrumSlots[0][head], frame.spectrum);
+    for (int r = 1; r < NUM_RESOLUTIONS; ++r) {
+        const int i = r - 1;
+        writeSpectrum(spectrumSlots[r][head], i < int(frame.extraSpectra.size()) ? frame.extraSpectra[i] : emptySpectrum);
+    }
+
+    head = (head + 1 == count) ? 0 : head + 1;
+}
+
+int TrackStore::size() const
+{
+    return count;
+}
+
+TrackStore::View<double> TrackStore::pitch() const
+{
+    return View<double>(pitches.data(), count, head);
+}
+
+TrackStore::View<double> TrackStore::oq() const
+{
+    return View<double>(oqs.data(), count, head);
+}
+
+TrackStore::View<int> TrackStore::formantCount() const
+{
+    return View<int>(formantCounts.data(), count, head);
+}
+
+TrackStore::View<double> TrackStore::formantFrequency(int k) const
+{
+    return View<double>(frequencies[k].data(), count, head);
+}
+
+TrackStore::View<double> TrackStore::formantBandwidth(int k) const
+{
+    return View<double>(bandwidths[k].data(), count, head);
+}
+
+TrackStore::View<SpecFrame> TrackStore::spectra(int resolution) const
+{
+    return View<SpecFrame>(spectrumSlots.at(resolution).data(), count, head);
+}
+
+Formant::Frame TrackStore::formantFrame(int iframe) const
+{
+    const int s = slot(iframe);
+
+    Formant::Frame frame;
+    frame.nFormants = formantCounts[s];
+    frame.formant.resize(frame.nFormants);
+    frame.intensity = 1.0;
+
+    for (int k = 0; k < frame.nFormants; ++k) {
+        frame.formant[k].frequency = frequencies[k][s];
+        frame.formant[k].bandwidth = bandwidths[k][s];
+    }
+
+    return frame;
+}
+
+void TrackStore::setFormantFrame(int iframe, const Formant::Frame & frame)
+{
+    writeFormants(slot(iframe), frame);
+}
+
+int TrackStore::slot(int iframe) const
+{
+    const int s = head + iframe;
+    return s >= count ? s - count : s;
+}
+
+void TrackStore::writeFormants(int s, const Formant::Frame & frame)
+{
+    const int n = std::min<int>(frame.formant.size(), MAX_FORMANTS);
+
+    formantCounts[s] = n;
+
+    for (int k = 0; k < n; ++k) {
+        frequencies[k][s] = frame.formant[k].frequency;
+        bandwidths[k][s] = frame.formant[k].bandwidth;
+    }
+}
+
+void TrackStore::writeSpectrum(SpecFrame & slot, const SpecFrame & spectrum)
+{
+    slot.fs = spectrum.fs;
+    slot.nfft = spectrum.nfft;
+    slot.binWidth = spectrum.binWidth;
+    slot.spec = spectrum.spec;
+}
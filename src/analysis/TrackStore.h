@@ -0,0 +1,94 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_TRACKSTORE_H
+#define SPEECH_ANALYSIS_TRACKSTORE_H
+
+#include <Eigen/Core>
+#include <vector>
+#include "AnalysisEngine.h"
+
+// Fixed-capacity history of analysis results, stored as one circular array
+// per quantity. The store is always full: index 0 is the oldest frame and
+// size() - 1 the newest, and frames older than the analysis are defaults.
+//
+// Only resize() allocates. push() overwrites the oldest slot in place,
+// reusing its spectrum storage when the FFT size has not changed.
+//
+// Each spectrum resolution has its own history: resolution 0 is the main
+// spectrum and resolution i the extra spectrum i - 1 of the frame.
+
+class TrackStore {
+public:
+    // LP orders go up to 22, so a frame has at most 11 formants.
+    static constexpr int MAX_FORMANTS = 11;
+    static constexpr int NUM_RESOLUTIONS = 1 + AnalysisEngine::MAX_EXTRA_SPECTRA;
+
+    // Read-only window over one circular array, indexed from the oldest frame.
+    template<typename T>
+    class View {
+    public:
+        View(const T * data, int count, int start)
+            : data(data), count(count), start(start) {}
+
+        const T & operator[](int i) const {
+            int j = start + i;
+            if (j >= count) {
+                j -= count;
+            }
+            return data[j];
+        }
+
+        [[nodiscard]] int size() const {
+            return count;
+        }
+
+    private:
+        const T * data;
+        int count;
+        int start;
+    };
+
+    TrackStore();
+
+    // Keeps the newest frames and pads the history with defaults.
+    void resize(int frameCount);
+
+    void push(const AnalysisFrame & frame);
+
+    [[nodiscard]] int size() const;
+
+    [[nodiscard]] View<double> pitch() const;
+    [[nodiscard]] View<double> oq() const;
+    [[nodiscard]] View<int> formantCount() const;
+    [[nodiscard]] View<double> formantFrequency(int k) const;
+    [[nodiscard]] View<double> formantBandwidth(int k) const;
+    // Frames without this resolution hold an empty spectrum.
+    [[nodiscard]] View<SpecFrame> spectra(int resolution = 0) const;
+
+    [[nodiscard]] Formant::Frame formantFrame(int iframe) const;
+    void setFormantFrame(int iframe, const Formant::Frame & frame);
+
+    static const SpecFrame defaultSpectrum;
+    static const SpecFrame emptySpectrum;
+
+private:
+    int slot(int iframe) const;
+
+    void writeFormants(int slot, const Formant::Frame & frame);
+    static void writeSpectrum(SpecFrame & slot, const SpecFrame & spectrum);
+
+    int count;
+    // Slot of the oldest frame, which push() overwrites next.
+    int head;
+
+    std::vector<double> pitches;
+    std::vector<double> oqs;
+    std::vector<int> formantCounts;
+    std::vector<std::vector<double>> frequencies;
+    std::vector<std::vector<double>> bandwidths;
+    std::vector<std::vector<SpecFrame>> spectrumSlots;
+};
+
+#endif //SPEECH_ANALYSIS_TRACKSTORE_H
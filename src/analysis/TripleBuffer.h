@@ -0,0 +1,71 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_TRIPLEBUFFER_H
+#define SPEECH_ANALYSIS_TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Wait-free single-producer/single-consumer hand-over of whole objects.
+//
+// The producer fills writeBuffer() and publishes it by swapping it with the
+// shared middle buffer; the consumer fetches by swapping its read buffer with
+// the middle one. Neither side ever waits for the other.
+//
+// publish() only succeeds once the consumer has fetched the previous buffer,
+// so a producer that accumulates into writeBuffer() until then never loses data.
+
+template<typename T>
+class TripleBuffer {
+public:
+    TripleBuffer()
+        : write(0), middle(1), read(2)
+    {
+    }
+
+    // Producer side.
+
+    T & writeBuffer() noexcept {
+        return buffers[write];
+    }
+
+    // Returns false if the consumer has not fetched the last published buffer yet.
+    bool publish() noexcept {
+        if (middle.load(std::memory_order_relaxed) & FRESH) {
+            return false;
+        }
+        // Only the producer sets FRESH, so the middle buffer cannot change under us.
+        write = middle.exchange(write | FRESH, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    // Consumer side.
+
+    // Returns true and swaps in the newest buffer if one was published since the last fetch.
+    bool fetch() noexcept {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        read = middle.exchange(read, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    T & readBuffer() noexcept {
+        return buffers[read];
+    }
+
+private:
+    static constexpr std::uint8_t INDEX = 0x3;
+    static constexpr std::uint8_t FRESH = 0x4;
+
+    std::array<T, 3> buffers;
+
+    alignas(64) std::uint8_t write;
+    alignas(64) std::atomic<std::uint8_t> middle;
+    alignas(64) std::uint8_t read;
+};
+
+#endif //SPEECH_ANALYSIS_TRIPLEBUFFER_H
@@ -2,39 +2,34 @@
 // Created by rika on 16/11/2019.
 //
 
-#include "../Analyser.h"
+#include "../AnalysisEngine.h"
 #include "LPC/Frame/LPC_Frame.h"
 
 using namespace Eigen;
 
-static const Formant::Frame defaultFrame = {
-    .nFormants = 5,
-    .formant = {{550, 60}, {1650, 60}, {2750, 60}, {3850, 60}, {4950, 60}},
-    .intensity = 1.0,
-};
-
-void Analyser::analyseFormant() {
-    if (lpFailed) {
-        lastFormantFrame = defaultFrame;
+void AnalysisEngine::analyseFormant(FrameContext & ctx) {
+    if (ctx.lpFailed) {
+        ctx.result.formants = defaultFrame;
         return;
     }
 
-    switch (formantMethod) {
+    switch (ctx.formantMethod) {
         case LP:
-            LPC::toFormantFrame(lpcFrame, lastFormantFrame, fs);
+            LPC::toFormantFrame(ctx.lpcFrame, ctx.result.formants, ctx.resampledRate);
             break;
         case KARMA:
-            analyseFormantEkf();
+            analyseFormantEkf(ctx);
             break;
     }
 }
 
-void Analyser::analyseFormantEkf() {
+void AnalysisEngine::analyseFormantEkf(FrameContext & ctx) {
 
     const int numF = ekfState.numF;
    
-    ekfState.voiced = (lastPitchFrame != 0);
-    ekfState.fs = this->fs;
+    ekfState.y = ctx.cepstrum;
+    ekfState.voiced = (ctx.result.pitch != 0);
+    ekfState.fs = ctx.resampledRate;
 
     EKF::step(ekfState);
    
@@ -50,6 +45,6 @@ void Analyser::analyseFormantEkf() {
 
     Formant::sort(frm);
 
-    lastFormantFrame = std::move(frm);
+    ctx.result.formants = std::move(frm);
 
 }
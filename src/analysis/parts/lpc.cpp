@@ -2,20 +2,20 @@
 // Created by rika on 16/11/2019.
 //
 
-#include "../Analyser.h"
+#include "../AnalysisEngine.h"
 #include "LPC/Frame/LPC_Frame.h"
 #include "Formant/EKF/EKF.h"
 
 using namespace Eigen;
 
-void Analyser::analyseLp() {
-    lpcFrame.nCoefficients = lpOrder;
-    lpFailed = !LPC::frame_burg(x, lpcFrame);
+void AnalysisEngine::analyseLp(FrameContext & ctx) {
+    ctx.lpcFrame.nCoefficients = ctx.lpOrder;
+    ctx.lpFailed = !LPC::frame_burg(ctx.xr, ctx.lpcFrame);
 
-    if (!lpFailed) {
-        ekfState.y = EKF::genLPCC(lpcFrame.a, cepOrder);
+    if (!ctx.lpFailed) {
+        ctx.cepstrum = EKF::genLPCC(ctx.lpcFrame.a, ctx.cepOrder);
     }
     else {
-        ekfState.y.setZero(ekfState.cepOrder);
+        ctx.cepstrum.setZero(ctx.cepOrder);
     }
 }
@@ -1,15 +1,15 @@
-#include "../Analyser.h"
+#include "../AnalysisEngine.h"
 #include "GCOI/GCOI.h"
 
-void Analyser::analyseOq()
+void AnalysisEngine::analyseOq(FrameContext & ctx)
 {
-    if (lastPitchFrame != 0.0) {
-        std::vector<GCOI::GIPair> giPairs = GCOI::estimate_MultiProduct(x, fs, 3);
-        //std::vector<GCOI::GIPair> giPairs = GCOI::estimate_Sedreams(x, fs, lastPitchFrame);
+    if (ctx.result.pitch != 0.0) {
+        std::vector<GCOI::GIPair> giPairs = GCOI::estimate_MultiProduct(ctx.x, ctx.sampleRate, 3);
+        //std::vector<GCOI::GIPair> giPairs = GCOI::estimate_Sedreams(ctx.x, ctx.sampleRate, ctx.result.pitch);
 
-        lastOqFrame = GCOI::estimateOq(giPairs);
+        ctx.result.oq = GCOI::estimateOq(giPairs);
     }
     else {
-        lastOqFrame = 0.0;
+        ctx.result.oq = 0.0;
     }
 }
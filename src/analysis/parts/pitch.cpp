@@ -2,31 +2,68 @@
 // Created by rika on 16/11/2019.
 //
 
-#include "../Analyser.h"
+#include <algorithm>
+#include "../AnalysisEngine.h"
 #include "Pitch/Pitch.h"
 
 using namespace Eigen;
 
-void Analyser::analysePitch()
+// Longest period that YIN looks for.
+constexpr double yinMinF0 = 60.0;
+
+// AMDF lags are searched at about this rate, then refined.
+constexpr double amdfCoarseRate = 16000.0;
+
+Pitch::Estimator & AnalysisEngine::pitchEstimator(PitchAlg alg, double fs, int frameLength)
 {
-    Pitch::Estimation est{};
+    auto & estimator = pitchEstimators[alg];
+
+    if (estimator
+            && estimator->config().sampleRate == fs
+            && estimator->config().frameLength == frameLength) {
+        return *estimator;
+    }
+
+    const double nyquist = fs / 2;
 
-    switch (pitchAlg) {
+    switch (alg) {
         case Wavelet:
-            Pitch::estimate_DynWav(x, fs, est, 6, 3000, 12, 0.35, lastPitchFrame);
+            estimator = std::make_unique<Pitch::DynamicWavelet>(
+                    Pitch::Estimator::Config{fs, frameLength, 0, 3000}, 6, 12, 0.35);
             break;
         case McLeod:
-            Pitch::estimate_MPM(x, fs, est);
+            estimator = std::make_unique<Pitch::McLeodEstimator>(
+                    Pitch::Estimator::Config{fs, frameLength, 60, nyquist});
             break;
         case YIN:
-            Pitch::estimate_YIN(x, fs, est, 0.30);
+            estimator = std::make_unique<Pitch::YinEstimator>(
+                    Pitch::Estimator::Config{fs, frameLength, yinMinF0, nyquist}, 0.10);
             break;
         case AMDF:
-            Pitch::estimate_AMDF(x, fs, est, 90, 1000, 4.0, 0.1);
+            estimator = std::make_unique<Pitch::AmdfEstimator>(
+                    Pitch::Estimator::Config{fs, frameLength, 90, 1000}, 4.0, 0.1, std::max<int>(fs / amdfCoarseRate, 1));
             break;
-        default:
-            est.isVoiced = false;
+        case FastYIN:
+            estimator = std::make_unique<Pitch::FastYinEstimator>(
+                    Pitch::Estimator::Config{fs, frameLength, yinMinF0, nyquist}, 0.10);
+            break;
+    }
+
+    return *estimator;
+}
+
+void AnalysisEngine::analysePitch(FrameContext & ctx)
+{
+    const ArrayXd & x = ctx.x;
+
+    Pitch::Estimation est{};
+
+    if (ctx.pitchAlg >= 0 && ctx.pitchAlg < NUM_PITCH_ALGS) {
+        pitchEstimator(ctx.pitchAlg, ctx.sampleRate, x.size()).estimate(x, est);
+    }
+    else {
+        est.isVoiced = false;
     }
 
-    lastPitchFrame = est.isVoiced ? est.pitch : 0;
+    ctx.result.pitch = est.isVoiced ? est.pitch : 0;
 }
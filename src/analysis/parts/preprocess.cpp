@@ -2,28 +2,38 @@
 // Created by clo on 25/11/2019.
 //
 
-#include "../Analyser.h"
+#include "../AnalysisEngine.h"
 #include "Signal/Filter.h"
 #include "Signal/Window.h"
 
 using namespace Eigen;
 
-void Analyser::applyWindow()
+constexpr double preEmphasisFrequency = 150.0;
+
+void AnalysisEngine::applyWindow(FrameContext & ctx)
 {
     // Apply Hanning window.
-    static ArrayXd win(0);
-    if (win.size() != x.size()) {
-        win = Window::createGaussian(x.size());
+    if (ctx.window.size() != ctx.xr.size()) {
+        ctx.window = Window::createGaussian(ctx.xr.size()).cast<float>();
+    }
+    ctx.xr *= ctx.window;
+}
+
+void AnalysisEngine::applyPreEmphasis(FrameContext & ctx)
+{
+    const double fs = ctx.resampledRate;
+
+    if (preEmphasisFrequency < fs / 2.0) {
+        Filter::preEmphasis(ctx.xr, fs, 0.68);
     }
-    x *= win;
 }
 
-void Analyser::applyPreEmphasis()
+void AnalysisEngine::applySpectrumPreEmphasis(FrameContext & ctx)
 {
-    constexpr double preEmphasisFrequency = 150.0;
+    // Uses the resampled rate like the LP branch, although x_fft is not resampled.
+    const double fs = ctx.resampledRate;
 
     if (preEmphasisFrequency < fs / 2.0) {
-        Filter::preEmphasis(x, fs, 0.68);
-        Filter::preEmphasis(x_fft, fs, preEmphasisFrequency);
+        Filter::preEmphasis(ctx.x_fft, fs, preEmphasisFrequency);
     }
 }
@@ -2,31 +2,25 @@
 // Created by rika on 16/11/2019.
 //
 
-#include "../Analyser.h"
+#include "../AnalysisEngine.h"
 #include "Signal/Resample.h"
 
 using namespace Eigen;
 
-static ArrayXd resample(ma_resampler * resampler, ArrayXd x) {
-    ArrayXf xf = x.cast<float>();
-
+static void resample(ma_resampler * resampler, const ArrayXf & x, ArrayXf & y) {
     ma_uint64 inCount = x.size();
     ma_uint64 outCount = ma_resampler_get_expected_output_frame_count(resampler, inCount);
 
-    float *yf = new float[outCount];
-
-    ma_resampler_process_pcm_frames(resampler, xf.data(), &inCount, yf, &outCount);
-
-    ArrayXd y = Map<ArrayXf>(yf, outCount).cast<double>();
+    // The resampler works in single precision, like the rest of this branch.
+    y.resize(outCount);
 
-    delete[] yf;
+    ma_resampler_process_pcm_frames(resampler, x.data(), &inCount, y.data(), &outCount);
 
-    return std::move(y);
+    y.conservativeResize(outCount);
 }
 
-void Analyser::resampleAudio() {
-    x = resample(&resampler, x);
-    fs = resampler.config.sampleRateOut;
+void AnalysisEngine::resampleAudio(FrameContext & ctx) {
+    resample(&resampler, ctx.xf, ctx.xr);
 
     /*if (nsamples > fftSamples) {
         x_fft = x.segment(x.size() / 2 - nfft / 2, nfft);
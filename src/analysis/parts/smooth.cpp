@@ -3,6 +3,7 @@
 #include <deque>
 //#include "MedianFilter.hpp"
 #include "../Analyser.h"
+#include "../../log/Trace.h"
 
 // Lowpass filter (Bessel, 0.08 cutoff, order 6)
 
@@ -38,15 +39,14 @@ static void smoothenFormants(const Formant::Frames& in, Formant::Frames& out);
 
 void Analyser::applySmoothingFilters()
 {
+    TRACE_SCOPE("Analyser::applySmoothingFilters");
+
+    // Smoothing is disabled, so the GUI reads the raw tracks directly.
     //smoothenPitch(pitchTrack, smoothedPitch);
-    smoothedPitch = pitchTrack;
    
     /*if (formantMethod == LP) {
         smoothenFormants(formantTrack, smoothedFormants);
-    }
-    else {*/
-        smoothedFormants = formantTrack;
-    //}
+    }*/
 }
 
 void smoothenPitch(const std::deque<double>& in, std::deque<double>& out)
@@ -3,60 +3,124 @@
 //
 
 #include <iostream>
-#include "../Analyser.h"
+#include "../AnalysisEngine.h"
 #include "FFT/FFT.h"
+#include "LPC/Frame/LPC_Frame.h"
 #include "Signal/Filter.h"
 #include "Signal/Window.h"
 #include "Signal/Resample.h"
 
 using namespace Eigen;
 
-void Analyser::analyseSpectrum()
+void AnalysisEngine::analyseSpectrum(FrameContext & ctx)
 {
     // Speech signal spectrum
-    
-    rfft_plan(nfft);
 
-    Map<ArrayXd> xin(rfft_in(nfft), nfft);
-    Map<ArrayXd> xout(rfft_out(nfft), nfft);
-    
-    xin = x_fft.head(nfft) * Window::createHanning(nfft); 
+    const int nfft = ctx.nfft;
 
-    rfft(nfft);
-    
-    lastSpectrumFrame.fs = audioInterface->getSampleRate();
-    lastSpectrumFrame.nfft = nfft;
-    lastSpectrumFrame.spec = xout;
+    ctx.result.spectrum.fs = ctx.sampleRate;
+    ctx.result.spectrum.nfft = nfft;
 
-    // LPC spectrum
+    if (!spectrumEnabled) {
+        ctx.result.spectrum.binWidth = 0;
+        ctx.result.spectrum.spec.resize(0);
+        ctx.result.extraSpectra.clear();
+        return;
+    }
 
-    constexpr int nfftLpc = 128;
-    const int p = lpcFrame.nCoefficients;
+    // Once for every FFT size.
+    applySpectrumPreEmphasis(ctx);
 
-    rfft_plan(nfftLpc);
+    // Before the zoomed spectrum windows its samples in place.
+    analyseExtraSpectra(ctx);
 
-    Map<ArrayXd> yin(rfft_in(nfftLpc), nfftLpc);
-    Map<ArrayXd> yout(rfft_out(nfftLpc), nfftLpc);
+    auto x = ctx.x_fft.tail(nfft);
 
-    ArrayXd h;
+    if (ctx.fftWindow.size() != nfft) {
+        ctx.fftWindow = Window::createHanning(nfft).cast<float>();
+    }
 
-    yin.setZero();
-    yin(0) = 0.5;
+    // One-sided power spectrum: the negative frequencies double the amplitude.
 
-    rfft(nfftLpc);
+    if (zoomSpectrum) {
+        x *= ctx.fftWindow;
+        zoomSpectrum->transform(x, ctx.zoomBins);
 
-    h = yout;
+        ctx.result.spectrum.binWidth = maximumFrequency / zoomSpectrum->outputSize();
+        ctx.result.spectrum.spec = 4 * ctx.zoomBins.abs2().cast<double>();
+        return;
+    }
 
-    yin.setZero();
-    yin(0) = 1.0;
-    yin.segment(1, p) = lpcFrame.a;
+    if (slidingDft) {
+        slidingDft->update(x, ctx.advance);
+        slidingDft->power(ctx.result.spectrum.spec);
 
-    rfft(nfftLpc);
+        ctx.result.spectrum.binWidth = ctx.sampleRate / nfft;
+        ctx.result.spectrum.spec *= 4;
+        return;
+    }
 
-    h /= yout;
+    auto & plan = fft_cached_plan<RCFFT, float>(nfft);
 
-    lpcSpectrum.fs = fs;
-    lpcSpectrum.nfft = nfftLpc;
-    lpcSpectrum.spec = h;
+    plan.input() = x * ctx.fftWindow;
 
+    plan.execute();
+
+    ctx.result.spectrum.binWidth = ctx.sampleRate / nfft;
+    ctx.result.spectrum.spec = 4 * plan.output().abs2().cast<double>();
+}
+
+void AnalysisEngine::analyseExtraSpectra(FrameContext & ctx)
+{
+    const int count = ctx.extraFftSizes.size();
+
+    ctx.extraFftWindows.resize(count);
+    ctx.result.extraSpectra.resize(count);
+
+    for (int i = 0; i < count; ++i) {
+        const int n = ctx.extraFftSizes[i];
+
+        if (ctx.extraFftWindows[i].size() != n) {
+            ctx.extraFftWindows[i] = Window::createHanning(n).cast<float>();
+        }
+
+        auto & plan = fft_cached_plan<RCFFT, float>(n);
+
+        plan.input() = ctx.x_fft.tail(n) * ctx.extraFftWindows[i];
+
+        plan.execute();
+
+        SpecFrame & spectrum = ctx.result.extraSpectra[i];
+        spectrum.fs = ctx.sampleRate;
+        spectrum.nfft = n;
+        spectrum.binWidth = ctx.sampleRate / n;
+        spectrum.spec = 4 * plan.output().abs2().cast<double>();
+    }
+}
+
+void AnalysisEngine::averageSpectrum(SpecFrame & spectrum)
+{
+    spectrumHistory[spectrumHistoryNext] = spectrum.spec;
+    spectrumHistoryNext = (spectrumHistoryNext + 1) % spectrumAveraging;
+    spectrumHistoryCount = std::min(spectrumHistoryCount + 1, spectrumAveraging);
+
+    for (int k = 1; k < spectrumHistoryCount; ++k) {
+        spectrum.spec += spectrumHistory[(spectrumHistoryNext + spectrumAveraging - 1 - k) % spectrumAveraging];
+    }
+    spectrum.spec /= spectrumHistoryCount;
+}
+
+void AnalysisEngine::analyseLpcSpectrum(FrameContext & ctx)
+{
+    // LPC spectrum: only the predictor and its rate. Consumers evaluate the
+    // envelope on their own grid with LPC::envelope.
+
+    const double fs = ctx.resampledRate;
+
+    ctx.result.lpcSpectrum.fs = fs;
+    ctx.result.lpcSpectrum.nfft = 0;
+    ctx.result.lpcSpectrum.binWidth = 0;
+    ctx.result.lpcSpectrum.spec.resize(0);
+
+    ctx.result.lpc = ctx.lpcFrame;
 }
@@ -1,6 +1,13 @@
 #include "../Analyser.h"
 
 void Analyser::trackFormants() {
+
+    const auto pitchTrack = tracks.pitch();
+
+    Formant::Frames formantTrack(frameCount);
+    for (int i = 0; i < frameCount; ++i) {
+        formantTrack[i] = tracks.formantFrame(i);
+    }
    
     Formant::Frames finalTrack(frameCount);
 
@@ -54,6 +61,8 @@ void Analyser::trackFormants() {
 
     }
 
-    formantTrack = std::move(finalTrack);
+    for (int i = 0; i < frameCount; ++i) {
+        tracks.setFormantFrame(i, finalTrack[i]);
+    }
 
 }
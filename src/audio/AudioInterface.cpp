@@ -15,12 +15,18 @@ AudioInterface::AudioInterface(ma_context * maCtx, SineWave * sineWave)
     L_INFO("Initialising audio capture buffer...");
 
     recordContext.sampleRate = sampleRate;
+    recordContext.numChannels = 0;
+    recordContext.traceBuffer = Trace::reserveThread("audio capture");
     playbackContext.sineWave = sineWave;
+
+    loadSettings();
 }
 
 AudioInterface::~AudioInterface()
 {
     closeStream();
+    saveSettings();
+    Trace::releaseThread(recordContext.traceBuffer);
 }
 
 void AudioInterface::openInputDevice(const ma_device_id * id)
@@ -48,6 +54,7 @@ void AudioInterface::openInputDevice(const ma_device_id * id)
     }
     
     recordContext.numChannels = deviceCapture.capture.channels;
+    _updateChannelWeights();
     
     deviceCaptureInit = true;
     
@@ -84,6 +91,7 @@ void AudioInterface::openOutputDevice(const ma_device_id * id)
     }
 
     recordContext.numChannels = deviceCapture.capture.channels;
+    _updateChannelWeights();
     
     deviceCaptureInit = true; 
 
@@ -151,14 +159,121 @@ void AudioInterface::closeStream()
 }
 
 void AudioInterface::setCaptureDuration(int nsamples) {
-    recordContext.buffer.setCapacity(nsamples);
+    const int capacity = BUFFER_SAMPLE_COUNT(sampleRate, nsamples);
+
+    if (capacity <= recordContext.buffer.getCapacity()) {
+        return;
+    }
+
+    // The buffer can only be resized while the audio callback is not running.
+    const bool wasStarted = deviceCaptureInit && ma_device_is_started(&deviceCapture);
+
+    if (wasStarted) {
+        ma_device_stop(&deviceCapture);
+    }
+
+    recordContext.buffer.setCapacity(capacity);
+
+    if (wasStarted && ma_device_start(&deviceCapture) != MA_SUCCESS) {
+        L_FATAL("Failed to restart capture audio device...");
+        throw AudioException("Failed to start miniaudio device");
+    }
+}
+
+void AudioInterface::setChannelWeights(const std::vector<float> & weights) {
+    channelWeights = weights;
+    _updateChannelWeights();
+}
+
+const std::vector<float> & AudioInterface::getChannelWeights() const noexcept {
+    return channelWeights;
+}
+
+void AudioInterface::_updateChannelWeights() {
+    const int numChannels = recordContext.numChannels;
+
+    if (numChannels <= 0) {
+        return;
+    }
+
+    const bool useMean = (int(channelWeights.size()) != numChannels);
+
+    if (useMean && !channelWeights.empty()) {
+        LS_WARN("Channel weights do not match the " << numChannels << " input channels, using the mean");
+    }
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        const float weight = useMean ? 1.0f / numChannels : channelWeights[ch];
+        recordContext.channelWeights[ch].store(weight, std::memory_order_relaxed);
+    }
 }
 
 int AudioInterface::getSampleRate() const noexcept {
     return sampleRate;
 }
 
-void AudioInterface::readBlock(Eigen::ArrayXd & capture) noexcept {
-    recordContext.buffer.readFrom(capture);
+bool AudioInterface::readBlock(Eigen::ArrayXf & capture) noexcept {
+    return recordContext.buffer.readFrom(capture);
+}
+
+bool AudioInterface::readBlockAt(std::uint64_t position, Eigen::ArrayXf & capture) noexcept {
+    return recordContext.buffer.readAt(position, capture);
+}
+
+std::uint64_t AudioInterface::getCapturePosition() const noexcept {
+    return recordContext.buffer.getWritePosition();
 }
 
+int AudioInterface::getCaptureCapacity() const noexcept {
+    return recordContext.buffer.getCapacity();
+}
+
+std::uint64_t AudioInterface::getCaptureOldestPosition() const noexcept {
+    return recordContext.buffer.getOldestPosition();
+}
+
+bool AudioInterface::waitForCapture(std::uint64_t position, const std::chrono::milliseconds & timeout) {
+    std::unique_lock<std::mutex> lock(recordContext.arrivalLock);
+    return recordContext.arrival.wait_for(lock, timeout, [&]() { return getCapturePosition() >= position; });
+}
+
+std::uint64_t AudioInterface::getCaptureOverrunCount() const noexcept {
+    return recordContext.buffer.getOverrunCount();
+}
+
+std::uint64_t AudioInterface::getCaptureUnderrunCount() const noexcept {
+    return recordContext.buffer.getUnderrunCount();
+}
+
+void AudioInterface::loadSettings()
+{
+    QSettings settings;
+
+    L_INFO("Loading audio settings...");
+
+    settings.beginGroup("audio");
+
+    channelWeights.clear();
+    for (const auto & weight : settings.value("channelWeights").toList()) {
+        channelWeights.push_back(weight.value<float>());
+    }
+
+    settings.endGroup();
+}
+
+void AudioInterface::saveSettings()
+{
+    QSettings settings;
+
+    L_INFO("Saving audio settings...");
+
+    settings.beginGroup("audio");
+
+    QVariantList weights;
+    for (float weight : channelWeights) {
+        weights.append(weight);
+    }
+    settings.setValue("channelWeights", weights);
+
+    settings.endGroup();
+}
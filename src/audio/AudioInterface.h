@@ -7,18 +7,38 @@
 
 #include "miniaudio.h"
 #include <Eigen/Core>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
 #include "RingBuffer.h"
 #include "SineWave.h"
+#include "../log/Trace.h"
 
 #define CAPTURE_DURATION 50.0
 #define CAPTURE_SAMPLE_COUNT(sampleRate) ((CAPTURE_DURATION * sampleRate) / 1000)
 
-#define BUFFER_SAMPLE_COUNT(sampleRate) (CAPTURE_SAMPLE_COUNT(sampleRate))
+// Extra history kept in the capture buffer so the analysis can lag behind without losing samples.
+#define BUFFER_HEADROOM_DURATION 1000.0
+#define BUFFER_SAMPLE_COUNT(sampleRate, nsamples) ((nsamples) + (BUFFER_HEADROOM_DURATION * sampleRate) / 1000)
+
+// Frames downmixed per step in the record callback, on the stack.
+#define RECORD_CHUNK_FRAMES 256
 
 struct RecordContext {
     RingBuffer buffer;
     double sampleRate;
     int numChannels;
+    std::array<std::atomic<float>, MA_MAX_CHANNELS> channelWeights;
+
+    // Signalled by the callback after every block, without taking the lock.
+    std::mutex arrivalLock;
+    std::condition_variable arrival;
+
+    // Trace ring of the callback's thread, set up outside of it.
+    Trace::ThreadBuffer * traceBuffer;
 };
 
 struct PlaybackContext {
@@ -44,11 +64,37 @@ public:
 
     void setCaptureDuration(int nsamples);
 
+    // Per-channel downmix weights. An empty list, or one that does not match
+    // the device channel count, falls back to the mean of all channels.
+    void setChannelWeights(const std::vector<float> & weights);
+    [[nodiscard]] const std::vector<float> & getChannelWeights() const noexcept;
+
     [[nodiscard]] int getSampleRate() const noexcept;
 
-    void readBlock(Eigen::ArrayXd & capture) noexcept;
+    bool readBlock(Eigen::ArrayXf & capture) noexcept;
+    // Reads the captured samples starting at an absolute capture position.
+    bool readBlockAt(std::uint64_t position, Eigen::ArrayXf & capture) noexcept;
+
+    [[nodiscard]] std::uint64_t getCapturePosition() const noexcept;
+    [[nodiscard]] int getCaptureCapacity() const noexcept;
+    // Capture position of the oldest sample that can still be read. It also
+    // moves up to the capture position when setCaptureDuration() grows the
+    // buffer, since that discards what was captured.
+    [[nodiscard]] std::uint64_t getCaptureOldestPosition() const noexcept;
+
+    // Blocks until the capture position reaches `position` or the timeout
+    // expires, and returns whether the position was reached. A block that
+    // arrives just before the wait starts may only be noticed on timeout.
+    bool waitForCapture(std::uint64_t position, const std::chrono::milliseconds & timeout);
+    [[nodiscard]] std::uint64_t getCaptureOverrunCount() const noexcept;
+    [[nodiscard]] std::uint64_t getCaptureUnderrunCount() const noexcept;
 
 private:
+    void loadSettings();
+    void saveSettings();
+
+    void _updateChannelWeights();
+
     ma_context * maCtx;
     
     bool deviceCaptureInit;
@@ -59,6 +105,8 @@ private:
 
     double sampleRate;
 
+    std::vector<float> channelWeights;
+
     // Record context
     struct RecordContext recordContext;
 
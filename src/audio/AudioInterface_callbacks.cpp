@@ -4,18 +4,43 @@
 
 #include <iostream>
 #include "AudioInterface.h"
-
-using namespace Eigen;
+#include "Downmix.h"
+#include "../log/Trace.h"
 
 void AudioInterface::recordCallback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount)
 {
     auto context = static_cast<struct RecordContext *>(pDevice->pUserData);
 
-    ArrayXXd deinterleavedInput = Map<const ArrayXXf>((float *) pInput, context->numChannels, frameCount).cast<double>();
+    Trace::adoptThread(context->traceBuffer);
+    TRACE_SCOPE("AudioInterface::recordCallback");
+    auto input = static_cast<const float *>(pInput);
+
+    const int numChannels = context->numChannels;
+
+    float weights[MA_MAX_CHANNELS];
+    for (int ch = 0; ch < numChannels; ++ch) {
+        weights[ch] = context->channelWeights[ch].load(std::memory_order_relaxed);
+    }
+
+    // Mono input with unit gain goes straight into the buffer.
+    if (numChannels == 1 && weights[0] == 1.0f) {
+        context->buffer.writeInto(input, frameCount);
+        context->arrival.notify_one();
+        return;
+    }
+
+    // Nothing is allocated on the audio thread: downmix through a stack chunk.
+    float mixed[RECORD_CHUNK_FRAMES];
+
+    for (ma_uint32 offset = 0; offset < frameCount; offset += RECORD_CHUNK_FRAMES) {
+        const int count = std::min<ma_uint32>(RECORD_CHUNK_FRAMES, frameCount - offset);
+
+        Downmix::mix(input + offset * numChannels, numChannels, weights, count, mixed);
 
-    ArrayXd meanInput = deinterleavedInput.colwise().mean();
+        context->buffer.writeInto(mixed, count);
+    }
 
-    context->buffer.writeInto(meanInput);
+    context->arrival.notify_one();
 }
 
 void AudioInterface::playCallback(ma_device *pDevice, void *pOutput, const void *pInput, ma_uint32 frameCount)
@@ -0,0 +1,171 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include "Downmix.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define DOWNMIX_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DOWNMIX_NEON
+#endif
+
+static void mixGeneric(const float * in, int numChannels, const float * w, int start, int frameCount, float * out)
+{
+    for (int i = start; i < frameCount; ++i) {
+        const float * frame = in + i * numChannels;
+        float y = 0.0f;
+        for (int ch = 0; ch < numChannels; ++ch) {
+            y += w[ch] * frame[ch];
+        }
+        out[i] = y;
+    }
+}
+
+#if defined(DOWNMIX_SSE)
+
+static int mix1(const float * in, const float * w, int frameCount, float * out)
+{
+    const __m128 w0 = _mm_set1_ps(w[0]);
+    int i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        _mm_storeu_ps(out + i, _mm_mul_ps(w0, _mm_loadu_ps(in + i)));
+    }
+    return i;
+}
+
+static int mix2(const float * in, const float * w, int frameCount, float * out)
+{
+    const __m128 ww = _mm_setr_ps(w[0], w[1], w[0], w[1]);
+    int i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        // Two frames per register: sum the even and odd lanes.
+        const __m128 a = _mm_mul_ps(ww, _mm_loadu_ps(in + 2 * i));
+        const __m128 b = _mm_mul_ps(ww, _mm_loadu_ps(in + 2 * i + 4));
+        const __m128 even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 odd = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_add_ps(even, odd));
+    }
+    return i;
+}
+
+static int mix4(const float * in, const float * w, int frameCount, float * out)
+{
+    const __m128 ww = _mm_loadu_ps(w);
+    int i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        // One frame per register: transpose and sum the rows.
+        __m128 f0 = _mm_mul_ps(ww, _mm_loadu_ps(in + 4 * i));
+        __m128 f1 = _mm_mul_ps(ww, _mm_loadu_ps(in + 4 * i + 4));
+        __m128 f2 = _mm_mul_ps(ww, _mm_loadu_ps(in + 4 * i + 8));
+        __m128 f3 = _mm_mul_ps(ww, _mm_loadu_ps(in + 4 * i + 12));
+        _MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_add_ps(f0, f1), _mm_add_ps(f2, f3)));
+    }
+    return i;
+}
+
+static int mix8(const float * in, const float * w, int frameCount, float * out)
+{
+    const __m128 wlo = _mm_loadu_ps(w);
+    const __m128 whi = _mm_loadu_ps(w + 4);
+    int i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        const float * p = in + 8 * i;
+        __m128 f0 = _mm_add_ps(_mm_mul_ps(wlo, _mm_loadu_ps(p)), _mm_mul_ps(whi, _mm_loadu_ps(p + 4)));
+        __m128 f1 = _mm_add_ps(_mm_mul_ps(wlo, _mm_loadu_ps(p + 8)), _mm_mul_ps(whi, _mm_loadu_ps(p + 12)));
+        __m128 f2 = _mm_add_ps(_mm_mul_ps(wlo, _mm_loadu_ps(p + 16)), _mm_mul_ps(whi, _mm_loadu_ps(p + 20)));
+        __m128 f3 = _mm_add_ps(_mm_mul_ps(wlo, _mm_loadu_ps(p + 24)), _mm_mul_ps(whi, _mm_loadu_ps(p + 28)));
+        _MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_add_ps(f0, f1), _mm_add_ps(f2, f3)));
+    }
+    return i;
+}
+
+#elif defined(DOWNMIX_NEON)
+
+static int mix1(const float * in, const float * w, int frameCount, float * out)
+{
+    int i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        vst1q_f32(out + i, vmulq_n_f32(vld1q_f32(in + i), w[0]));
+    }
+    return i;
+}
+
+static int mix2(const float * in, const float * w, int frameCount, float * out)
+{
+    int i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        const float32x4x2_t ch = vld2q_f32(in + 2 * i);
+        float32x4_t y = vmulq_n_f32(ch.val[0], w[0]);
+        y = vmlaq_n_f32(y, ch.val[1], w[1]);
+        vst1q_f32(out + i, y);
+    }
+    return i;
+}
+
+static int mix4(const float * in, const float * w, int frameCount, float * out)
+{
+    int i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        const float32x4x4_t ch = vld4q_f32(in + 4 * i);
+        float32x4_t y = vmulq_n_f32(ch.val[0], w[0]);
+        y = vmlaq_n_f32(y, ch.val[1], w[1]);
+        y = vmlaq_n_f32(y, ch.val[2], w[2]);
+        y = vmlaq_n_f32(y, ch.val[3], w[3]);
+        vst1q_f32(out + i, y);
+    }
+    return i;
+}
+
+static int mix8(const float * in, const float * w, int frameCount, float * out)
+{
+    // De-interleaving by four puts channels k and k + 4 of two frames in val[k].
+    float32x4_t ww[4];
+    for (int k = 0; k < 4; ++k) {
+        const float lanes[4] = {w[k], w[k + 4], w[k], w[k + 4]};
+        ww[k] = vld1q_f32(lanes);
+    }
+
+    int i = 0;
+    for (; i + 2 <= frameCount; i += 2) {
+        const float32x4x4_t ch = vld4q_f32(in + 8 * i);
+        float32x4_t s = vmulq_f32(ch.val[0], ww[0]);
+        s = vmlaq_f32(s, ch.val[1], ww[1]);
+        s = vmlaq_f32(s, ch.val[2], ww[2]);
+        s = vmlaq_f32(s, ch.val[3], ww[3]);
+        vst1_f32(out + i, vpadd_f32(vget_low_f32(s), vget_high_f32(s)));
+    }
+    return i;
+}
+
+#endif
+
+void Downmix::mix(const float * in, const int numChannels, const float * weights, const int frameCount, float * out) noexcept
+{
+    int done = 0;
+
+#if defined(DOWNMIX_SSE) || defined(DOWNMIX_NEON)
+    switch (numChannels) {
+        case 1:
+            done = mix1(in, weights, frameCount, out);
+            break;
+        case 2:
+            done = mix2(in, weights, frameCount, out);
+            break;
+        case 4:
+            done = mix4(in, weights, frameCount, out);
+            break;
+        case 8:
+            done = mix8(in, weights, frameCount, out);
+            break;
+        default:
+            break;
+    }
+#endif
+
+    mixGeneric(in, numChannels, weights, done, frameCount, out);
+}
@@ -0,0 +1,16 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_DOWNMIX_H
+#define SPEECH_ANALYSIS_DOWNMIX_H
+
+namespace Downmix {
+
+    // Weighted sum of the channels of interleaved f32 frames into a mono signal.
+    // Does not allocate; uses SIMD for 1, 2, 4 and 8 channels where available.
+    void mix(const float * in, int numChannels, const float * weights, int frameCount, float * out) noexcept;
+
+}
+
+#endif //SPEECH_ANALYSIS_DOWNMIX_H
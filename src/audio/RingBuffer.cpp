@@ -2,66 +2,160 @@
 // Created by rika on 11/10/2019.
 //
 
+#include <algorithm>
 #include "RingBuffer.h"
 
 using namespace Eigen;
 
+static int roundUpToPowerOfTwo(int n)
+{
+    int p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
 RingBuffer::RingBuffer(int capacity)
-    : capacity(capacity), writeCursor(0)
+    : validPosition(0), writePosition(0), reservePosition(0), overruns(0), underruns(0)
 {
-    data.resize(capacity, 0.0);
+    setCapacity(capacity);
 }
 
-void RingBuffer::writeInto(const ArrayXd & in)
+void RingBuffer::writeInto(const float * in, int count) noexcept
 {
-    std::lock_guard<std::mutex> lock(mut);
+    const std::uint64_t w = writePosition.load(std::memory_order_relaxed);
 
-    const int toWrite = in.size();
-    const int tailCount = capacity - writeCursor;
+    // A consumer that sees any of the new samples also sees this.
+    reservePosition.store(w + count, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
 
-    auto dataIt = data.begin() + writeCursor;
+    if (capacity > 0) {
+        // Only the newest `capacity` samples of an oversized block can survive.
+        const int skip = std::max(0, count - capacity);
+        const int toWrite = count - skip;
 
-    if (toWrite <= tailCount) {
-        std::copy_n(in.begin(), toWrite, dataIt);
-    }
-    else {
-        auto inputIt = in.begin() + tailCount;
+        const int writeCursor = (w + skip) & mask;
+        const int tailCount = std::min(toWrite, capacity - writeCursor);
 
-        std::copy_n(in.begin(), tailCount, dataIt);
-        std::copy_n(inputIt, toWrite - tailCount, data.begin());
+        std::copy_n(in + skip, tailCount, data.begin() + writeCursor);
+        std::copy_n(in + skip + tailCount, toWrite - tailCount, data.begin());
     }
 
-    writeCursor = (writeCursor + toWrite) % capacity;
+    writePosition.store(w + count, std::memory_order_release);
 }
 
-void RingBuffer::readFrom(ArrayXd & out)
+bool RingBuffer::readFrom(ArrayXf & out) noexcept
 {
-    std::lock_guard<std::mutex> lock(mut);
+    const std::int64_t w = writePosition.load(std::memory_order_acquire);
 
-    const int toRead = out.size();
-    const int toReadRoundedUp = (1 + (toRead / capacity)) * capacity;
+    return copyOut(w - out.size(), out);
+}
 
-    const int readCursor = (toReadRoundedUp + writeCursor - toRead) % capacity;
-    const int tailCount = capacity - readCursor;
+bool RingBuffer::readAt(std::uint64_t position, ArrayXf & out) noexcept
+{
+    return copyOut(position, out);
+}
+
+bool RingBuffer::copyOut(std::int64_t position, ArrayXf & out) noexcept
+{
+    const std::int64_t n = out.size();
+    if (n == 0) {
+        return true;
+    }
 
-    auto dataIt = data.begin() + readCursor;
+    const std::int64_t w1 = writePosition.load(std::memory_order_acquire);
+    const std::int64_t oldest1 = oldestFor(w1);
 
-    if (toRead <= tailCount) {
-        std::copy_n(dataIt, toRead, out.begin());
+    bool complete = true;
+
+    // Samples before the start of the stream or past the write position
+    // have not been captured yet; samples older than the buffer, or from
+    // before the last resize, were lost.
+    // Waiting for the first n samples of the stream is not an underrun.
+    if (position < 0 || position + n > w1) {
+        if (position + n > w1 && w1 >= n) {
+            underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        complete = false;
+    }
+    if (position + n > 0 && position < oldest1) {
+        overruns.fetch_add(1, std::memory_order_relaxed);
+        complete = false;
+    }
+
+    std::int64_t begin = std::max(position, oldest1);
+    const std::int64_t end = std::min(position + n, w1);
+
+    if (begin >= end) {
+        out.setZero();
+        return false;
     }
-    else {
-        auto outputIt = out.begin() + tailCount;
 
-        std::copy_n(dataIt, tailCount, out.begin());
-        std::copy_n(data.begin(), toRead - tailCount, outputIt);
+    const int readCursor = begin & mask;
+    const int toRead = end - begin;
+    const int tailCount = std::min(toRead, capacity - readCursor);
+
+    auto outIt = out.begin() + (begin - position);
+
+    std::copy_n(data.begin() + readCursor, tailCount, outIt);
+    std::copy_n(data.begin(), toRead - tailCount, outIt + tailCount);
+
+    // Check whether the producer lapped us while we were copying, counting
+    // the block it may still be in the middle of.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const std::int64_t w2 = reservePosition.load(std::memory_order_relaxed);
+    const std::int64_t oldest2 = oldestFor(w2);
+
+    if (begin < oldest2) {
+        overruns.fetch_add(1, std::memory_order_relaxed);
+        complete = false;
+        begin = std::min(oldest2, end);
     }
+
+    // Zero whatever could not be read reliably.
+    out.head(begin - position).setZero();
+    out.tail(position + n - end).setZero();
+
+    return complete;
+}
+
+std::uint64_t RingBuffer::getWritePosition() const noexcept
+{
+    return writePosition.load(std::memory_order_acquire);
+}
+
+std::uint64_t RingBuffer::getOverrunCount() const noexcept
+{
+    return overruns.load(std::memory_order_relaxed);
+}
+
+std::uint64_t RingBuffer::getUnderrunCount() const noexcept
+{
+    return underruns.load(std::memory_order_relaxed);
+}
+
+int RingBuffer::getCapacity() const noexcept
+{
+    return capacity;
+}
+
+std::uint64_t RingBuffer::getOldestPosition() const noexcept
+{
+    return oldestFor(writePosition.load(std::memory_order_acquire));
+}
+
+std::int64_t RingBuffer::oldestFor(std::int64_t w) const noexcept
+{
+    return std::max<std::int64_t>({0, w - capacity, static_cast<std::int64_t>(validPosition)});
 }
 
 void RingBuffer::setCapacity(int newCapacity)
 {
-    std::lock_guard<std::mutex> lock(mut);
+    capacity = newCapacity > 0 ? roundUpToPowerOfTwo(newCapacity) : 0;
+    mask = capacity > 0 ? capacity - 1 : 0;
 
-    capacity = newCapacity;
-    data.resize(capacity, 0.0);
-    writeCursor = 0;
-}
\ No newline at end of file
+    // Samples captured before the resize are lost, but positions stay monotonic.
+    data.assign(capacity, 0.0f);
+    validPosition = writePosition.load(std::memory_order_relaxed);
+}
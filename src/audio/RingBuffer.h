@@ -6,22 +6,60 @@
 #define SPEECH_ANALYSIS_RINGBUFFER_H
 
 #include <Eigen/Core>
-#include <mutex>
+#include <atomic>
+#include <climits>
+#include <cstdint>
 #include <vector>
 
+// Wait-free single-producer/single-consumer sample buffer.
+//
+// The producer (the audio callback) never blocks: it overwrites the oldest
+// samples and publishes its monotonic write position with a release store.
+// The consumer (the analysis thread) addresses samples by their absolute
+// position in the capture stream and detects when the producer lapped it.
+
 class RingBuffer {
 public:
     explicit RingBuffer(int capacity = 0);
 
-    void writeInto(const Eigen::ArrayXd & in);
-    void readFrom(Eigen::ArrayXd & out);
+    // Producer side.
+    void writeInto(const float * in, int count) noexcept;
+
+    // Consumer side. Both return false if part of the block was lost
+    // (overrun) or has not been captured yet (underrun); missing samples are zeroed.
+    // Reads before the first out.size() samples were captured are not
+    // counted as underruns.
+    bool readFrom(Eigen::ArrayXf & out) noexcept;
+    bool readAt(std::uint64_t position, Eigen::ArrayXf & out) noexcept;
 
+    [[nodiscard]] std::uint64_t getWritePosition() const noexcept;
+    [[nodiscard]] std::uint64_t getOverrunCount() const noexcept;
+    [[nodiscard]] std::uint64_t getUnderrunCount() const noexcept;
+    [[nodiscard]] int getCapacity() const noexcept;
+    // Position of the oldest sample still held. Older samples were either
+    // overwritten or discarded by setCapacity().
+    [[nodiscard]] std::uint64_t getOldestPosition() const noexcept;
+
+    // Not safe while the producer is running. Discards the samples held so
+    // far: reads before the current write position then fail as overruns.
     void setCapacity(int newCapacity);
 
 private:
-    int capacity, writeCursor;
-    std::vector<double> data;
-    std::mutex mut;
+    bool copyOut(std::int64_t position, Eigen::ArrayXf & out) noexcept;
+    std::int64_t oldestFor(std::int64_t w) const noexcept;
+
+    int capacity;
+    // Write position at the last setCapacity(). Nothing before it is held.
+    std::uint64_t validPosition;
+    std::uint64_t mask;
+    std::vector<float> data;
+
+    alignas(64) std::atomic<std::uint64_t> writePosition;
+    // End of the block being written, published before the samples it
+    // overwrites are touched.
+    std::atomic<std::uint64_t> reservePosition;
+    alignas(64) std::atomic<std::uint64_t> overruns;
+    std::atomic<std::uint64_t> underruns;
 };
 
 template<typename T>
@@ -8,6 +8,7 @@
 #include "MFCC/MFCC.h"
 #include "../Exceptions.h"
 #include "../log/simpleQtLogger.h"
+#include "../log/Trace.h"
 
 using namespace Eigen;
 
@@ -19,6 +20,8 @@ AnalyserCanvas::AnalyserCanvas(Analyser * analyser, SineWave * sineWave) noexcep
       frequencyScaleType(2),
       minGain(-60),
       maxGain(0),
+      spectrumResolution(0),
+      redrawSpectrogram(false),
       analyser(analyser),
       sineWave(sineWave),
 #ifdef Q_OS_ANDROID
@@ -57,6 +60,7 @@ AnalyserCanvas::~AnalyserCanvas() {
 }
 
 void AnalyserCanvas::render() {
+    TRACE_SCOPE("AnalyserCanvas::render");
 
     imageLock.lock();
 
@@ -74,15 +78,17 @@ void AnalyserCanvas::render() {
 
 }
 
-void AnalyserCanvas::renderTracks(const int nframe, const double maximumFrequency, FormantMethod formantAlg, const std::deque<double> &pitches, const Formant::Frames &formants) {
+void AnalyserCanvas::renderTracks(const int nframe, const double maximumFrequency, FormantMethod formantAlg, const TrackStore &trackStore) {
+    TRACE_SCOPE("AnalyserCanvas::renderTracks");
+
     std::lock_guard<std::mutex> guard(imageLock);
 
     tracks.fill(Qt::transparent);
-    renderFormantTrack(nframe, maximumFrequency, formantAlg, pitches, formants);
-    renderPitchTrack(nframe, maximumFrequency, pitches);
+    renderFormantTrack(nframe, maximumFrequency, formantAlg, trackStore);
+    renderPitchTrack(nframe, maximumFrequency, trackStore);
 }
 
-void AnalyserCanvas::renderFormantTrack(const int nframe, const double maximumFrequency, FormantMethod formantAlg, const std::deque<double> &pitches, const Formant::Frames &formants) {
+void AnalyserCanvas::renderFormantTrack(const int nframe, const double maximumFrequency, FormantMethod formantAlg, const TrackStore &trackStore) {
 
     const double xstep = upFactorTracks * (double) targetWidth / (double) nframe;
 
@@ -95,22 +101,31 @@ void AnalyserCanvas::renderFormantTrack(const int nframe, const double maximumFr
         f = true;
     }
 
+    const auto pitches = trackStore.pitch();
+    const auto formantCounts = trackStore.formantCount();
+
+    std::vector<TrackStore::View<double>> frequencies;
+    for (int k = 0; k < TrackStore::MAX_FORMANTS; ++k) {
+        frequencies.push_back(trackStore.formantFrequency(k));
+    }
+
     for (int iframe = 0; iframe < nframe; ++iframe) {
     
         const double x = iframe * xstep;
 
-        const auto & frame = formants.at(iframe);
-        const double pitch = pitches.at(iframe);
+        const double pitch = pitches[iframe];
 
         int formantNb = 0;
-        for (const auto & formant : frame.formant) {
-            if (formant.frequency <= 0) {
+        for (int k = 0; k < formantCounts[iframe]; ++k) {
+            const double frequency = frequencies[k][iframe];
+
+            if (frequency <= 0) {
                 startPath[formantNb] = true;
                 formantNb++;
                 continue;
             }
 
-            const double y = upFactorTracks * yFromFrequency(formant.frequency, maximumFrequency);
+            const double y = upFactorTracks * yFromFrequency(frequency, maximumFrequency);
 
             QColor c;
             if (pitch != 0 && formantNb < 4) {    
@@ -154,11 +169,13 @@ void AnalyserCanvas::renderFormantTrack(const int nframe, const double maximumFr
     }
 }
 
-void AnalyserCanvas::renderPitchTrack(const int nframe, const double maximumFrequency, const std::deque<double> &pitches) {
+void AnalyserCanvas::renderPitchTrack(const int nframe, const double maximumFrequency, const TrackStore &trackStore) {
     const double xstep = upFactorTracks * (double) targetWidth / (double) nframe;
     
     QPainter tPainter(&tracks);
 
+    const auto pitches = trackStore.pitch();
+
     QPainterPath path;
     bool beginTrack = true;
 
@@ -166,7 +183,7 @@ void AnalyserCanvas::renderPitchTrack(const int nframe, const double maximumFreq
 
         const double x = iframe * xstep;
 
-        const double pitch = pitches.at(iframe);
+        const double pitch = pitches[iframe];
 
         if (pitch > 0) {
             const double y = upFactorTracks * yFromFrequency(pitch, maximumFrequency);
@@ -190,6 +207,8 @@ void AnalyserCanvas::renderPitchTrack(const int nframe, const double maximumFreq
 }
 
 void AnalyserCanvas::renderScaleAndCursor(const int nframe, const double maximumFrequency) {
+    TRACE_SCOPE("AnalyserCanvas::renderScaleAndCursor");
+
     std::lock_guard<std::mutex> guard(imageLock);
 
     constexpr int ruleSmall = 4;
@@ -259,19 +278,30 @@ void AnalyserCanvas::renderScaleAndCursor(const int nframe, const double maximum
     painter.setFont(font);
 }
 
-void AnalyserCanvas::renderSpectrogram(const int nframe, const int nNew, const double maximumFrequency, std::deque<SpecFrame>::const_iterator begin, std::deque<SpecFrame>::const_iterator end)
+void AnalyserCanvas::renderSpectrogram(const int nframe, const int nNew, const double maximumFrequency, const TrackStore & trackStore)
 {
+    TRACE_SCOPE("AnalyserCanvas::renderSpectrogram");
+
     std::lock_guard<std::mutex> guard(imageLock);
     
     struct Tile { int r, g, b; double y, y2; };
 
     const double xstep = upFactorSpec;
 
-    QImage spectrogramSnapshot = spectrogram.copy();
-    spectrogram.fill(Qt::transparent);
-    QPainter scrollPainter(&spectrogram);
-    scrollPainter.drawImage(QPointF{-nNew * xstep, 0}, spectrogramSnapshot);
-    scrollPainter.end();
+    int nDraw = nNew;
+
+    if (redrawSpectrogram) {
+        spectrogram.fill(Qt::transparent);
+        nDraw = nframe;
+        redrawSpectrogram = false;
+    }
+    else {
+        QImage spectrogramSnapshot = spectrogram.copy();
+        spectrogram.fill(Qt::transparent);
+        QPainter scrollPainter(&spectrogram);
+        scrollPainter.drawImage(QPointF{-nNew * xstep, 0}, spectrogramSnapshot);
+        scrollPainter.end();
+    }
    
     QPainter sPainter(&spectrogram);
     sPainter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
@@ -279,27 +309,24 @@ void AnalyserCanvas::renderSpectrogram(const int nframe, const int nNew, const d
     const auto & cmrMap = colorMaps.find(colorMapName)->second;
     const int cmrCount = cmrMap.size();
 
-    auto it = begin;
+    const auto spectra = trackStore.spectra(spectrumResolution);
 
-    int iframe = nframe - 1 - nNew;
-
-    while (it != end) {
+    for (int iframe = std::max(0, nframe - 1 - nDraw); iframe < nframe; ++iframe) {
         QVector<Tile> rects;
 
         const double x = iframe * xstep;
-        const auto &sframe = *it;
+        const auto &sframe = spectra[iframe];
 
-        const double delta = sframe.fs / (2 * sframe.nfft);
+        const double delta = sframe.binWidth;
 
-        for (int i = 0; i < sframe.nfft; ++i) {
+        for (int i = 0; i < sframe.spec.size(); ++i) {
             const double y = upFactorSpec * yFromFrequency(i * delta, maximumFrequency);
             const double y2 = upFactorSpec * yFromFrequency((i + 1) * delta, maximumFrequency);
 
             if (y < 0 || y2 >= upFactorSpec * targetHeight)
                 continue;
 
-            double amplitude = abs(sframe.spec(i));
-            double dB = std::clamp<double>(20.0 * log10(amplitude), minGain, maxGain);
+            double dB = std::clamp<double>(10.0 * log10(sframe.spec(i)), minGain, maxGain);
 
             double cmrInd = (cmrCount - 1) - (cmrCount - 1) * static_cast<double>(maxGain - dB) / static_cast<double>(maxGain - minGain);
             
@@ -354,9 +381,6 @@ void AnalyserCanvas::renderSpectrogram(const int nframe, const int nNew, const d
             
             prevRect = rect;
         }
-
-        iframe++;
-        it++;
     }
 }
 
@@ -582,6 +606,21 @@ int AnalyserCanvas::getMaxGainSpectrum() const {
     return maxGain;
 }
 
+void AnalyserCanvas::setSpectrumResolution(int resolution) {
+    std::lock_guard<std::mutex> guard(imageLock);
+
+    resolution = std::clamp(resolution, 0, TrackStore::NUM_RESOLUTIONS - 1);
+
+    if (resolution != spectrumResolution) {
+        spectrumResolution = resolution;
+        redrawSpectrogram = true;
+    }
+}
+
+int AnalyserCanvas::getSpectrumResolution() const {
+    return spectrumResolution;
+}
+
 void AnalyserCanvas::loadSettings() {
     QSettings settings;
 
@@ -612,6 +651,8 @@ void AnalyserCanvas::loadSettings() {
     setMinGainSpectrum(settings.value("minGain", -40).value<int>());
     setMaxGainSpectrum(settings.value("maxGain", 20).value<int>());
 
+    setSpectrumResolution(settings.value("spectrumResolution", 0).value<int>());
+
     settings.endGroup();
 }
 
@@ -640,5 +681,7 @@ void AnalyserCanvas::saveSettings() {
     settings.setValue("minGain", minGain);
     settings.setValue("maxGain", maxGain);
 
+    settings.setValue("spectrumResolution", spectrumResolution);
+
     settings.endGroup();
 }
@@ -36,6 +36,8 @@ public:
     void setSpectrumColor(const QString & name);
     void setMinGainSpectrum(int gain);
     void setMaxGainSpectrum(int gain);
+    // Redraws the whole spectrogram from that resolution's history.
+    void setSpectrumResolution(int resolution);
 
     int getFrequencyScale() const;
     bool getDrawSpectrum() const;
@@ -47,6 +49,7 @@ public:
     const QString & getSpectrumColor() const;
     int getMinGainSpectrum() const;
     int getMaxGainSpectrum() const;
+    int getSpectrumResolution() const;
 
 protected:
     void mouseMoveEvent(QMouseEvent * event) override;
@@ -57,8 +60,8 @@ protected:
 
     friend class Analyser;
 public slots:
-    void renderTracks(int nframe, double maxFreq, FormantMethod formantAlg, const std::deque<double> & pitches, const Formant::Frames & formants);
-    void renderSpectrogram(int nframe, int nNew, double maxFreq, std::deque<SpecFrame>::const_iterator begin, std::deque<SpecFrame>::const_iterator end);
+    void renderTracks(int nframe, double maxFreq, FormantMethod formantAlg, const TrackStore & tracks);
+    void renderSpectrogram(int nframe, int nNew, double maxFreq, const TrackStore & tracks);
     void renderScaleAndCursor(int nframe, double maxFreq);
 
 private:
@@ -68,8 +71,8 @@ private:
     void cursorMoveEvent(QMouseEvent * event);
 
     void render();
-    void renderPitchTrack(int nframe, double maxFreq, const std::deque<double> &pitches);
-    void renderFormantTrack(int nframe, double maxFreq, FormantMethod formantAlg, const std::deque<double> &pitches, const Formant::Frames &formants);
+    void renderPitchTrack(int nframe, double maxFreq, const TrackStore &tracks);
+    void renderFormantTrack(int nframe, double maxFreq, FormantMethod formantAlg, const TrackStore &tracks);
 
     double yFromFrequency(double frequency, double maxFreq);
     double frequencyFromY(int y, double maxFreq);
@@ -96,6 +99,10 @@ private:
 
     int minGain, maxGain;
 
+    int spectrumResolution;
+    // Set when the spectrogram must be redrawn from the whole history.
+    bool redrawSpectrogram;
+
     bool drawSpectrum, drawTracks;
     int frequencyScaleType;
     int selectedFrame;
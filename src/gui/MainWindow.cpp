@@ -6,6 +6,8 @@
 #include "ColorMaps.h"
 #include "FFT/FFT.h"
 #include "../log/simpleQtLogger.h"
+#include "../log/Trace.h"
+#include "../Exceptions.h"
 #ifdef Q_OS_ANDROID
     #include <QtAndroid>
     #include <QAndroidIntent>
@@ -16,8 +18,11 @@
 constexpr int maxWidthComboBox = 200;
 
 MainWindow::MainWindow()
-    : fftSizes{"64", "128", "256", "512", "1024", "2048"}
+    : fftSizes{"64", "128", "256", "512", "1024", "2048"},
+      spectrumBinCounts{"Full band", "128", "256", "512", "1024"},
+      secondFftSizes{"None", "64", "128", "256", "512", "1024", "2048"}
 {
+    Trace::setThreadName("gui");
 
     L_INFO("Initialising miniaudio context...");
 
@@ -67,8 +72,13 @@ MainWindow::MainWindow()
     audioInterface = new AudioInterface(&maCtx, sineWave);
 #endif
 
+    loadFftWisdom();
+
     analyser = new Analyser(audioInterface);
 
+    // The analyser has planned its transforms by now.
+    saveFftWisdom();
+
     QPalette palette = this->palette();
 
     central = new QWidget;
@@ -201,6 +211,32 @@ MainWindow::MainWindow()
             connect(inputFftSize, QOverload<const QString &>::of(&QComboBox::currentIndexChanged),
                     [&](const QString value) { analyser->setFftSize(value.toInt()); });
 
+            inputSecondFftSize = new QComboBox;
+            inputSecondFftSize->addItems(secondFftSizes);
+
+            // "None" reads as 0, which the analyser drops.
+            connect(inputSecondFftSize, QOverload<const QString &>::of(&QComboBox::currentIndexChanged),
+                    [&](const QString value) { analyser->setExtraFftSizes({value.toInt()}); });
+
+            inputSpectrumBins = new QComboBox;
+            inputSpectrumBins->addItems(spectrumBinCounts);
+
+            // "Full band" reads as 0.
+            connect(inputSpectrumBins, QOverload<const QString &>::of(&QComboBox::currentIndexChanged),
+                    [&](const QString value) { analyser->setSpectrumBins(value.toInt()); });
+
+            inputSpectrumAveraging = new QSpinBox;
+            inputSpectrumAveraging->setRange(1, 16);
+            inputSpectrumAveraging->setSuffix(" frames");
+
+            connect(inputSpectrumAveraging, QOverload<int>::of(&QSpinBox::valueChanged),
+                    [&](const int value) { analyser->setSpectrumAveraging(value); });
+
+            inputSlidingSpectrum = new QCheckBox;
+
+            connect(inputSlidingSpectrum, &QCheckBox::toggled,
+                    [&](const bool checked) { analyser->setSlidingSpectrum(checked); });
+
             inputLpOrder = new QSpinBox;
             inputLpOrder->setRange(5, 22);
 
@@ -245,6 +281,7 @@ MainWindow::MainWindow()
                 "McLeod",
                 "YIN",
                 "AMDF",
+                "YIN (early stop)",
             });
 
             connect(inputPitchAlg, QOverload<int>::of(&QComboBox::currentIndexChanged),
@@ -262,6 +299,10 @@ MainWindow::MainWindow()
             ly1->addRow("Audio device:", devWidget);
             ly1->addRow("Display settings:", inputDisplayDialog);
             ly1->addRow("FFT size:", inputFftSize);
+            ly1->addRow("Second FFT size:", inputSecondFftSize);
+            ly1->addRow("Spectrum bins:", inputSpectrumBins);
+            ly1->addRow("Spectrum averaging:", inputSpectrumAveraging);
+            ly1->addRow("Sliding spectrum:", inputSlidingSpectrum);
             ly1->addRow("Linear prediction order:", inputLpOrder);
             ly1->addRow("Maximum frequency:", inputMaxFreq);
             ly1->addRow("Frame length:", inputFrameLength);
@@ -307,6 +348,12 @@ MainWindow::MainWindow()
                 [&](const int value) { canvas->setMaxGainSpectrum(value);
                                        inputMinGain->setMaximum(value - 10); });
 
+        inputSpectrumResolution = new QComboBox;
+        inputSpectrumResolution->addItems({"FFT size", "Second FFT size"});
+
+        connect(inputSpectrumResolution, QOverload<int>::of(&QComboBox::currentIndexChanged),
+                [&](const int value) { canvas->setSpectrumResolution(value); });
+
         inputFreqScale = new QComboBox;
         inputFreqScale->addItems({"Linear", "Logarithmic", "Mel"});
 
@@ -377,6 +424,7 @@ MainWindow::MainWindow()
         ly1->addRow("Show tracks:", inputToggleTracks);
         ly1->addRow("Minimum gain:", inputMinGain);
         ly1->addRow("Maximum gain:", inputMaxGain);
+        ly1->addRow("Spectrogram from:", inputSpectrumResolution);
         ly1->addRow("Frequency scale:", inputFreqScale);
 
         ly1->addRow("Pitch thickness:", inputPitchThick);
@@ -528,9 +576,33 @@ MainWindow::~MainWindow() {
     delete devs;
     ma_context_uninit(&maCtx);
 
+    saveFftWisdom();
     all_fft_cleanup();
 }
 
+void MainWindow::loadFftWisdom() {
+    QSettings settings;
+    const int planning = settings.value("fft/planning", static_cast<int>(FFTPlanMeasure)).value<int>();
+    fft_set_planning(static_cast<FFTPlanning>(std::clamp(planning, 0, 2)));
+
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QDir().mkpath(dir);
+    fftWisdomPath = fft_wisdom_path(dir.toStdString());
+
+    if (fft_load_wisdom(fftWisdomPath)) {
+        LS_INFO("Loaded FFTW wisdom from " << QString::fromStdString(fftWisdomPath));
+    }
+    else {
+        LS_INFO("No FFTW wisdom at " << QString::fromStdString(fftWisdomPath) << ", transforms will be planned");
+    }
+}
+
+void MainWindow::saveFftWisdom() {
+    if (!fft_save_wisdom(fftWisdomPath)) {
+        LS_WARN("Unable to save FFTW wisdom to " << QString::fromStdString(fftWisdomPath));
+    }
+}
+
 void MainWindow::updateFields() {
 
     const int frame = canvas->getSelectedFrame();
@@ -652,6 +724,25 @@ void MainWindow::toggleFullscreen() {
     }
 }
 
+void MainWindow::toggleTrace() {
+    if (!Trace::isEnabled()) {
+        Trace::clear();
+        Trace::setEnabled(true);
+        L_INFO("Started collecting a performance trace...");
+        return;
+    }
+
+    Trace::setEnabled(false);
+
+    try {
+        Trace::writeJson(TRACE_FILE_NAME);
+        L_INFO("Performance trace written to " TRACE_FILE_NAME);
+    }
+    catch (const FileException &) {
+        L_WARN("Unable to write the performance trace to " TRACE_FILE_NAME);
+    }
+}
+
 bool MainWindow::eventFilter(QObject * obj, QEvent * event)
 {
     if (event->type() == QEvent::KeyPress) {
@@ -671,6 +762,10 @@ bool MainWindow::eventFilter(QObject * obj, QEvent * event)
                 toggleFullscreen();
                 return true;
             }
+            else if (key == Qt::Key_T) {
+                toggleTrace();
+                return true;
+            }
         }
         else if (obj == dialogDisplay) {
             if (key == Qt::Key_Escape) {
@@ -699,6 +794,10 @@ void MainWindow::loadSettings()
     // Assume that analysis settings have already loaded and corrected if necessary.
    
     int nfft = analyser->getFftSize();
+    std::vector<int> extraFftSizes = analyser->getExtraFftSizes();
+    int spectrumBins = analyser->getSpectrumBins();
+    int spectrumAveraging = analyser->getSpectrumAveraging();
+    bool slidingSpectrum = analyser->getSlidingSpectrum();
     int lpOrder = analyser->getLinearPredictionOrder();
     double maxFreq = analyser->getMaximumFrequency();
     int cepOrder = analyser->getCepstralOrder();
@@ -715,6 +814,7 @@ void MainWindow::loadSettings()
     bool drawTracks = canvas->getDrawTracks();
     int minGain = canvas->getMinGainSpectrum();
     int maxGain = canvas->getMaxGainSpectrum();
+    int spectrumResolution = canvas->getSpectrumResolution();
     int pitchThick = canvas->getPitchThickness();
     int formantThick = canvas->getFormantThickness();
     QString colorMapName = canvas->getSpectrumColor();
@@ -725,11 +825,25 @@ void MainWindow::loadSettings()
         fftInd = fftSizes.indexOf("512");
     }
 
+    int secondFftInd = extraFftSizes.empty() ? -1 : secondFftSizes.indexOf(QString::number(extraFftSizes.front()));
+    if (secondFftInd < 0) {
+        secondFftInd = 0;
+    }
+
+    int binsInd = spectrumBinCounts.indexOf(QString::number(spectrumBins));
+    if (binsInd < 0) {
+        binsInd = 0;
+    }
+
 #ifndef Q_OS_ANDROID
 
 #define callWithBlocker(obj, call) do { QSignalBlocker blocker(obj); (obj) -> call; } while (false)
 
     callWithBlocker(inputFftSize, setCurrentIndex(fftInd));
+    callWithBlocker(inputSecondFftSize, setCurrentIndex(secondFftInd));
+    callWithBlocker(inputSpectrumBins, setCurrentIndex(binsInd));
+    callWithBlocker(inputSpectrumAveraging, setValue(spectrumAveraging));
+    callWithBlocker(inputSlidingSpectrum, setChecked(slidingSpectrum));
     callWithBlocker(inputLpOrder, setValue(lpOrder));
     callWithBlocker(inputMaxFreq, setValue(maxFreq));
     callWithBlocker(inputFrameLength, setValue(frameLength));
@@ -743,6 +857,7 @@ void MainWindow::loadSettings()
     callWithBlocker(inputFreqScale, setCurrentIndex(freqScale));
     callWithBlocker(inputMinGain, setValue(minGain));
     callWithBlocker(inputMaxGain, setValue(maxGain));
+    callWithBlocker(inputSpectrumResolution, setCurrentIndex(spectrumResolution));
     callWithBlocker(inputPitchThick, setValue(pitchThick));
     callWithBlocker(inputFormantThick, setValue(formantThick));
 
@@ -23,6 +23,9 @@ Q_DECLARE_METATYPE(DevicePair);
 
 constexpr int numFormants = 4;
 
+// Written to the working directory, next to the log file.
+#define TRACE_FILE_NAME "speechanalysis.trace.json"
+
 extern QFont * appFont;
 
 class MainWindow : public QMainWindow {
@@ -37,14 +40,17 @@ protected:
 #endif
 
 signals:
-    void newFramesTracks(int nframe, double maxFreq, FormantMethod formantAlg, const std::deque<double> & pitches, const Formant::Frames & formants);
-    void newFramesSpectrum(int nframe, int nNew, double maxFreq, std::deque<SpecFrame>::const_iterator begin, std::deque<SpecFrame>::const_iterator end);
-    void newFramesLpc(double maxFreq, SpecFrame lpcFrame);
+    void newFramesTracks(int nframe, double maxFreq, FormantMethod formantAlg, const TrackStore & tracks);
+    void newFramesSpectrum(int nframe, int nNew, double maxFreq, const TrackStore & tracks);
+    void newFramesLpc(double maxFreq, double lpcSampleRate, const LPC::Frame & lpc);
     void newFramesUI(int nframe, double maxFreq);
 
 private:
     void loadSettings();
 
+    void loadFftWisdom();
+    void saveFftWisdom();
+
     void updateFields();
 #ifndef Q_OS_ANDROID
     void updateDevices();
@@ -52,6 +58,7 @@ private:
 
     void toggleAnalyser();
     void toggleFullscreen();
+    void toggleTrace();
 #else
     void openSettings();
 #endif
@@ -69,6 +76,9 @@ private:
     QTimer timer;
 
     QStringList fftSizes;
+    QStringList spectrumBinCounts;
+    QStringList secondFftSizes;
+    std::string fftWisdomPath;
 
     QWidget * central;
 
@@ -82,6 +92,10 @@ private:
     QPushButton * inputDevRefresh;
     QPushButton * inputDisplayDialog;
     QComboBox * inputFftSize;
+    QComboBox * inputSecondFftSize;
+    QComboBox * inputSpectrumBins;
+    QSpinBox * inputSpectrumAveraging;
+    QCheckBox * inputSlidingSpectrum;
     QSpinBox * inputLpOrder;
     QSpinBox * inputMaxFreq;
     QSpinBox * inputFrameLength;
@@ -96,6 +110,7 @@ private:
     QSpinBox * inputMinGain;
     QSpinBox * inputMaxGain;
     QComboBox * inputFreqScale;
+    QComboBox * inputSpectrumResolution;
     QSpinBox * inputPitchThick;
     QPushButton * inputPitchColor;
     QSpinBox * inputFormantThick;
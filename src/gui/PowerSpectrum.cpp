@@ -1,7 +1,9 @@
 #include <Eigen/Dense>
 #include <iostream>
 #include "PowerSpectrum.h"
+#include "LPC/Frame/LPC_Frame.h"
 #include "MFCC/MFCC.h"
+#include "../log/Trace.h"
 
 PowerSpectrum::PowerSpectrum(Analyser * analyser, AnalyserCanvas * canvas)
     : analyser(analyser), canvas(canvas),
@@ -11,6 +13,7 @@ PowerSpectrum::PowerSpectrum(Analyser * analyser, AnalyserCanvas * canvas)
     SpecFrame frame;
     frame.nfft = 1;
     frame.fs = 16000;
+    frame.binWidth = 16000;
     frame.spec.setOnes(1);
 
     Eigen::ArrayXd one;
@@ -19,10 +22,16 @@ PowerSpectrum::PowerSpectrum(Analyser * analyser, AnalyserCanvas * canvas)
     holdLength = 25;
     hold.resize(holdLength, frame);
     holdIndex = 0;
+
+    targetWidth = 1;
+    targetHeight = 1;
+    lpcGridMaxFreq = 0;
 }
 
-void PowerSpectrum::renderSpectrum(const int nframe, const int nNew, const double maximumFrequency, std::deque<SpecFrame>::const_iterator begin, std::deque<SpecFrame>::const_iterator end)
+void PowerSpectrum::renderSpectrum(const int nframe, const int nNew, const double maximumFrequency, const TrackStore & tracks)
 {
+    TRACE_SCOPE("PowerSpectrum::renderSpectrum");
+
     using Eigen::ArrayXd;
   
     std::lock_guard<std::mutex> guard(imageLock);
@@ -35,60 +44,39 @@ void PowerSpectrum::renderSpectrum(const int nframe, const int nNew, const doubl
     QPainter painter(&spectrum);
     painter.setRenderHints(QPainter::Antialiasing | QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
 
-    const double fs = begin->fs;
-    
+    const auto spectra = tracks.spectra(canvas->getSpectrumResolution());
+
     // Advance the hold buffer.
-    for (auto it = begin; it != end; ++it) {
-        const auto & frame = *it;
+    for (int iframe = std::max(0, nframe - 1 - nNew); iframe < nframe; ++iframe) {
+        const auto & frame = spectra[iframe];
 
         hold[holdIndex] = frame;
         holdIndex = (holdIndex + 1) % holdLength;
     }
 
-    int maxNfft = 1;
-
-    for (const auto & holdFrame : hold) {
-        if (holdFrame.nfft > maxNfft) {
-            maxNfft = holdFrame.nfft;
-        }
-    }
-    
-    ArrayXd maxHold(maxNfft);
-    maxHold.setZero();
+    // Frames held from before a change of bins are left out.
+    const SpecFrame & latest = spectra[nframe - 1];
 
-    double maxAmplitude = 1e-16;
+    ArrayXd maxHold = latest.spec;
 
     for (const auto & holdFrame : hold) {
-        // Each frame needs to be resampled first.
-        int gap = maxNfft / holdFrame.nfft;
-
-        for (int i = 0; i < holdFrame.nfft; ++i) {
-            for (int j = gap * i; j < gap * (i + 1); ++j) {
-
-                if (holdFrame.spec(i) > maxHold(j)) {
-                    maxHold(j) = holdFrame.spec(i);
-                }
-
-            }
-
-            if (abs(holdFrame.spec(i)) > maxAmplitude) {
-                maxAmplitude = abs(holdFrame.spec(i));
-            }
+        if (holdFrame.spec.size() == maxHold.size() && holdFrame.binWidth == latest.binWidth) {
+            maxHold = maxHold.max(holdFrame.spec);
         }
     }
 
-    const double delta = fs / (2 * maxNfft);
+    const double delta = latest.binWidth;
 
     QPainterPath path;
 
-    for (int i = 0; i < maxNfft; ++i) {
+    for (int i = 0; i < maxHold.size(); ++i) {
         double freq = i * delta;
 
         if (freq > maximumFrequency) {
             break;
         }
 
-        double gain = std::clamp<double>(20 * std::log10(abs(maxHold(i))), minGain - 20, maxGain + 20);
+        double gain = std::clamp<double>(10 * std::log10(maxHold(i)), minGain - 20, maxGain + 20);
 
         int x = targetWidth - (targetWidth * (maxGain - gain)) / (maxGain - minGain);
         int y = yFromFrequency(freq, maximumFrequency);
@@ -105,15 +93,23 @@ void PowerSpectrum::renderSpectrum(const int nframe, const int nNew, const doubl
     painter.drawPath(path);
 }
 
-void PowerSpectrum::renderLpc(double maximumFrequency, SpecFrame lpcSpectrum)
+void PowerSpectrum::renderLpc(double maximumFrequency, double lpcSampleRate, const LPC::Frame & lpc)
 {
+    TRACE_SCOPE("PowerSpectrum::renderLpc");
+
     std::lock_guard<std::mutex> guard(imageLock);
-   
-    const double fs = lpcSpectrum.fs;
-    const int nfft = lpcSpectrum.nfft;
-    const auto& spec = lpcSpectrum.spec;
-    
-    const double delta = lpcSpectrum.fs / (2.0 * lpcSpectrum.nfft);
+
+    // One point per pixel row, from the bottom up.
+    if (lpcFrequencies.size() != targetHeight + 1 || lpcGridMaxFreq != maximumFrequency) {
+        lpcFrequencies.resize(targetHeight + 1);
+        for (int y = 0; y <= targetHeight; ++y) {
+            lpcFrequencies(y) = frequencyFromY(targetHeight - y, maximumFrequency);
+        }
+        lpcEnvelope.resize(targetHeight + 1);
+        lpcGridMaxFreq = maximumFrequency;
+    }
+
+    LPC::envelope(lpc, lpcFrequencies, lpcSampleRate, lpcEnvelope);
    
     int minGain = canvas->getMinGainSpectrum();
     int maxGain = canvas->getMaxGainSpectrum();
@@ -125,17 +121,11 @@ void PowerSpectrum::renderLpc(double maximumFrequency, SpecFrame lpcSpectrum)
 
     QPainterPath path;
 
-    for (int i = 0; i < nfft; ++i) {
-        double freq = i * delta;
-
-        if (freq > maximumFrequency) {
-            break;
-        }
-
-        double gain = std::clamp<double>(20 * std::log10(abs(spec(i))), minGain - 20, maxGain + 20);
+    for (int i = 0; i <= targetHeight; ++i) {
+        double gain = std::clamp<double>(20 * std::log10(lpcEnvelope(i)), minGain - 20, maxGain + 20);
 
         int x = targetWidth - (targetWidth * (maxGain - gain)) / (maxGain - minGain);
-        int y = yFromFrequency(freq, maximumFrequency);
+        int y = targetHeight - i;
       
         if (i == 0) {
             path.moveTo(x, y);
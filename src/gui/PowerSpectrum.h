@@ -16,14 +16,19 @@ protected:
     void paintEvent(QPaintEvent * event) override;
 
 public slots:
-    void renderSpectrum(int nframe, int nNew, double maximumFrequency, std::deque<SpecFrame>::const_iterator begin, std::deque<SpecFrame>::const_iterator end);
-    void renderLpc(double maxFreq, SpecFrame lpcSpectrum);
+    void renderSpectrum(int nframe, int nNew, double maximumFrequency, const TrackStore & tracks);
+    void renderLpc(double maxFreq, double lpcSampleRate, const LPC::Frame & lpc);
 
 private:
     double frequencyFromY(int y, double maximumFrequency);
     int yFromFrequency(double freq, double maximumFrequency);
 
     std::vector<SpecFrame> hold;
+
+    // Frequencies of the pixel rows, and the LP envelope at those rows.
+    Eigen::ArrayXd lpcFrequencies;
+    Eigen::ArrayXd lpcEnvelope;
+    double lpcGridMaxFreq;
     int holdLength, holdIndex;
 
     std::mutex imageLock;
@@ -25,6 +25,7 @@ JniInstance::JniInstance(Analyser * analyser, AnalyserCanvas * canvas, PowerSpec
         QStringLiteral("McLeod"),
         QStringLiteral("YIN"),
         QStringLiteral("AMDF"),
+        QStringLiteral("YIN (early stop)"),
     };
 
     java_pitchAlgs = QAndroidJniObject("java/util/ArrayList", "(I)V", pitchAlgs.size());
@@ -0,0 +1,291 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Trace.h"
+#include "../Exceptions.h"
+
+namespace {
+
+    struct Event {
+        const char * name;
+        std::int64_t begin;
+        std::int64_t end;
+    };
+
+    // Events kept per thread, a power of two.
+    constexpr std::uint64_t RING_CAPACITY = 1 << 16;
+
+}
+
+struct Trace::ThreadBuffer {
+    int tid;
+    std::atomic<const char *> name;
+
+    std::vector<Event> events;
+
+    // Written only by the owning thread.
+    std::atomic<std::uint64_t> written;
+    // Guarded by registryLock.
+    std::uint64_t clearedAt;
+    // Cleared without the lock when the owning thread exits, or for a
+    // reserved buffer, by releaseThread.
+    std::atomic<bool> owned;
+};
+
+namespace {
+
+    using Trace::ThreadBuffer;
+
+    const auto epoch = std::chrono::steady_clock::now();
+
+    std::mutex registryLock;
+    std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+    // Hands the buffer back when its thread exits, so that threads which come
+    // and go (such as the workers of short-lived engines) do not add up.
+    // Reserved buffers stay with whoever reserved them.
+    struct LocalBuffer {
+        ThreadBuffer * buffer = nullptr;
+        bool adopted = false;
+
+        ~LocalBuffer()
+        {
+            if (buffer && !adopted) {
+                buffer->owned.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local LocalBuffer localBuffer;
+
+    bool sameName(const char * a, const char * b)
+    {
+        return a == b || (a && b && std::strcmp(a, b) == 0);
+    }
+
+    ThreadBuffer * registerThread(const char * name)
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+
+        // Prefer the buffer of an exited thread with the same name, then any exited thread's.
+        ThreadBuffer * reuse = nullptr;
+        for (auto & buffer : registry) {
+            if (!buffer->owned.load(std::memory_order_acquire)
+                    && (reuse == nullptr || sameName(buffer->name.load(std::memory_order_relaxed), name))) {
+                reuse = buffer.get();
+            }
+        }
+
+        if (reuse == nullptr) {
+            auto buffer = std::make_unique<ThreadBuffer>();
+            buffer->tid = registry.size() + 1;
+            buffer->events.resize(RING_CAPACITY);
+            buffer->written.store(0, std::memory_order_relaxed);
+            buffer->clearedAt = 0;
+            registry.push_back(std::move(buffer));
+            reuse = registry.back().get();
+        }
+
+        reuse->name.store(name, std::memory_order_relaxed);
+        reuse->owned.store(true, std::memory_order_relaxed);
+        return reuse;
+    }
+
+    // Copies the events recorded since the last clear(), with registryLock held.
+    void collect(const ThreadBuffer & buffer, std::vector<Event> & events)
+    {
+        // The owning thread may keep recording, and may overwrite the oldest
+        // events while they are copied: those are dropped afterwards.
+        const std::uint64_t w1 = buffer.written.load(std::memory_order_acquire);
+        const std::uint64_t begin = std::max(buffer.clearedAt, w1 - std::min(w1, RING_CAPACITY));
+
+        events.clear();
+        for (std::uint64_t i = begin; i < w1; ++i) {
+            events.push_back(buffer.events[i & (RING_CAPACITY - 1)]);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const std::uint64_t w2 = buffer.written.load(std::memory_order_relaxed);
+        const std::uint64_t valid = w2 - std::min(w2, RING_CAPACITY);
+        const std::size_t lost = std::min<std::uint64_t>(events.size(), valid > begin ? valid - begin : 0);
+
+        events.erase(events.begin(), events.begin() + lost);
+    }
+
+    void writeEscaped(std::ostream & out, const char * str)
+    {
+        out << '"';
+        for (; *str; ++str) {
+            if (*str == '"' || *str == '\\') {
+                out << '\\';
+            }
+            out << *str;
+        }
+        out << '"';
+    }
+
+}
+
+std::atomic<bool> Trace::enabled(false);
+
+void Trace::setEnabled(bool value)
+{
+    enabled.store(value, std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(const char * name) noexcept
+{
+    if (localBuffer.buffer) {
+        localBuffer.buffer->name.store(name, std::memory_order_relaxed);
+        return;
+    }
+
+    try {
+        localBuffer.buffer = registerThread(name);
+    }
+    catch (...) {
+        // The thread's events are dropped.
+    }
+}
+
+Trace::ThreadBuffer * Trace::reserveThread(const char * name) noexcept
+{
+    try {
+        return registerThread(name);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void Trace::adoptThread(ThreadBuffer * buffer) noexcept
+{
+    if (localBuffer.buffer == buffer) {
+        return;
+    }
+    if (localBuffer.buffer && !localBuffer.adopted) {
+        localBuffer.buffer->owned.store(false, std::memory_order_release);
+    }
+    localBuffer.buffer = buffer;
+    localBuffer.adopted = true;
+}
+
+void Trace::releaseThread(ThreadBuffer * buffer) noexcept
+{
+    if (buffer == nullptr) {
+        return;
+    }
+
+    buffer->owned.store(false, std::memory_order_release);
+}
+
+std::int64_t Trace::now() noexcept
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const char * name, std::int64_t begin, std::int64_t end) noexcept
+{
+    ThreadBuffer * buffer = localBuffer.buffer;
+
+    // Registering here could lock and allocate on a real-time thread.
+    if (buffer == nullptr) {
+        return;
+    }
+
+    const std::uint64_t w = buffer->written.load(std::memory_order_relaxed);
+    buffer->events[w & (RING_CAPACITY - 1)] = {name, begin, end};
+    buffer->written.store(w + 1, std::memory_order_release);
+}
+
+void Trace::clear()
+{
+    std::lock_guard<std::mutex> lock(registryLock);
+
+    for (auto & buffer : registry) {
+        buffer->clearedAt = buffer->written.load(std::memory_order_acquire);
+    }
+}
+
+void Trace::writeJson(const std::string & path)
+{
+    std::ofstream file(path);
+    if (!file) {
+        throw FileException("Unable to open trace output file");
+    }
+
+    std::lock_guard<std::mutex> lock(registryLock);
+
+    std::vector<Event> events;
+    char buf[96];
+    bool first = true;
+
+    auto separator = [&]() {
+        file << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (const auto & buffer : registry) {
+        const char * name = buffer->name.load(std::memory_order_relaxed);
+
+        separator();
+        std::snprintf(buf, sizeof(buf), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", buffer->tid);
+        file << buf;
+        writeEscaped(file, name ? name : ("thread " + std::to_string(buffer->tid)).c_str());
+        file << "}}";
+
+        collect(*buffer, events);
+
+        for (const Event & e : events) {
+            separator();
+            file << "{\"name\":";
+            writeEscaped(file, e.name);
+            std::snprintf(buf, sizeof(buf), ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                          buffer->tid, e.begin / 1000.0, (e.end - e.begin) / 1000.0);
+            file << buf;
+        }
+    }
+
+    file << "\n]}\n";
+
+    if (!file) {
+        throw FileException("Unable to write trace output file");
+    }
+}
+
+std::vector<Trace::Total> Trace::totals()
+{
+    std::lock_guard<std::mutex> lock(registryLock);
+
+    std::vector<Event> events;
+    std::vector<Total> totals;
+
+    for (const auto & buffer : registry) {
+        collect(*buffer, events);
+
+        for (const Event & e : events) {
+            auto it = std::find_if(totals.begin(), totals.end(),
+                    [&](const Total & t) { return t.name == e.name; });
+            if (it == totals.end()) {
+                totals.push_back({e.name, 0, 0.0});
+                it = totals.end() - 1;
+            }
+            it->count++;
+            it->totalMs += (e.end - e.begin) / 1e6;
+        }
+    }
+
+    return totals;
+}
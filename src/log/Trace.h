@@ -0,0 +1,103 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_TRACE_H
+#define SPEECH_ANALYSIS_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped timers for profiling, exported as a Chrome/Perfetto trace.
+//
+// Each thread records into its own fixed-size ring of events, set up when
+// the thread is named, so recording never locks or allocates. Events of a
+// thread without a ring are dropped. The oldest events are overwritten when
+// a ring is full. While collection is disabled, a scope costs one relaxed
+// atomic load.
+//
+// Event names must be string literals or otherwise outlive the trace.
+
+namespace Trace {
+
+    extern std::atomic<bool> enabled;
+
+    inline bool isEnabled() noexcept {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool);
+
+    struct ThreadBuffer;
+
+    // Names the calling thread in exported traces and sets up its ring: the
+    // only lock and allocation of the thread, so call it once at its start.
+    void setThreadName(const char * name) noexcept;
+
+    // A ring set up ahead of time for a thread that must never lock or
+    // allocate and whose start we do not control, such as the audio
+    // callback's. Returns nullptr if it could not be allocated.
+    ThreadBuffer * reserveThread(const char * name) noexcept;
+
+    // Records the calling thread's events into a reserved ring from now on.
+    // It is only a pointer store, so a callback can call it every time.
+    void adoptThread(ThreadBuffer * buffer) noexcept;
+
+    // Hands a reserved ring back, once no thread records into it anymore.
+    void releaseThread(ThreadBuffer * buffer) noexcept;
+
+    // Nanoseconds since the first use of the trace clock.
+    std::int64_t now() noexcept;
+
+    void record(const char * name, std::int64_t begin, std::int64_t end) noexcept;
+
+    // Drops the events recorded so far.
+    void clear();
+
+    // Writes the events recorded since the last clear() in the Chrome trace
+    // event format, readable by chrome://tracing and ui.perfetto.dev.
+    void writeJson(const std::string & path);
+
+    struct Total {
+        std::string name;
+        std::uint64_t count;
+        double totalMs;
+    };
+
+    // Sums the events recorded since the last clear() by name, on all threads.
+    std::vector<Total> totals();
+
+    class Scope {
+    public:
+        explicit Scope(const char * name) noexcept
+            : name(isEnabled() ? name : nullptr),
+              begin(this->name ? now() : 0)
+        {
+        }
+
+        ~Scope()
+        {
+            if (name) {
+                record(name, begin, now());
+            }
+        }
+
+        Scope(const Scope &) = delete;
+        Scope & operator=(const Scope &) = delete;
+
+    private:
+        const char * name;
+        std::int64_t begin;
+    };
+
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+// Times the rest of the enclosing block.
+#define TRACE_SCOPE(name) Trace::Scope TRACE_CONCAT(traceScope_, __LINE__)(name)
+
+#endif //SPEECH_ANALYSIS_TRACE_H
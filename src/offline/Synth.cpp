@@ -0,0 +1,152 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <cmath>
+#include <random>
+#include "Synth.h"
+
+using namespace Eigen;
+
+// Formants above F3 are synthesised but not scored.
+static constexpr double upperFormants[][2] = {{3500, 200}, {4500, 250}};
+
+// Rosenberg pulse, rising over this fraction of the open phase.
+static constexpr double risingFraction = 0.6;
+
+// Breath noise in the unvoiced part, relative to the voiced RMS.
+static constexpr double breathLevel = 0.03;
+
+static void resonate(ArrayXd & x, double frequency, double bandwidth, double fs)
+{
+    const double r = std::exp(-M_PI * bandwidth / fs);
+    const double c = 2 * r * std::cos(2 * M_PI * frequency / fs);
+    // Unity gain at DC.
+    const double g = 1 - c + r * r;
+
+    double y1 = 0, y2 = 0;
+    for (int i = 0; i < x.size(); ++i) {
+        const double y = g * x(i) + c * y1 - r * r * y2;
+        y2 = y1;
+        y1 = y;
+        x(i) = y;
+    }
+}
+
+Synth::Signal Synth::generate(const Params & params)
+{
+    const double fs = params.sampleRate;
+    const int nVoiced = std::round(params.voicedDuration * fs);
+    const int nTotal = nVoiced + std::round(params.unvoicedDuration * fs);
+
+    std::mt19937 gen(params.seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+
+    Signal signal;
+    signal.params = params;
+    signal.f0.setZero(nTotal);
+
+    // Glottal flow, one period at a time.
+    ArrayXd flow = ArrayXd::Zero(nTotal);
+
+    double t = 0;
+    while (t < nVoiced) {
+        const double f0 = params.f0Start + (params.f0End - params.f0Start) * t / nVoiced;
+        const double period = (fs / f0) * (1 + params.jitter * normal(gen));
+        const double amplitude = 1 + params.shimmer * normal(gen);
+
+        const double open = params.openQuotient * period;
+        const double rising = risingFraction * open;
+        const double falling = open - rising;
+
+        const int begin = std::ceil(t);
+        const int end = std::min<int>(std::ceil(t + period), nVoiced);
+
+        for (int i = begin; i < end; ++i) {
+            const double u = i - t;
+            if (u < rising) {
+                flow(i) = amplitude * 0.5 * (1 - std::cos(M_PI * u / rising));
+            }
+            else if (u < open) {
+                flow(i) = amplitude * std::cos(M_PI * (u - rising) / (2 * falling));
+            }
+            signal.f0(i) = f0;
+        }
+
+        t += period;
+    }
+
+    // Lip radiation.
+    ArrayXd x(nTotal);
+    x(0) = flow(0);
+    x.tail(nTotal - 1) = flow.tail(nTotal - 1) - flow.head(nTotal - 1);
+
+    const double voicedRms = std::sqrt(x.head(nVoiced).square().mean());
+
+    for (int i = nVoiced; i < nTotal; ++i) {
+        x(i) = breathLevel * voicedRms * normal(gen);
+    }
+
+    for (int k = 0; k < NUM_FORMANTS; ++k) {
+        resonate(x, params.formants[k], params.bandwidths[k], fs);
+    }
+    for (const auto & [f, b] : upperFormants) {
+        resonate(x, f, b, fs);
+    }
+
+    const double filteredRms = std::sqrt(x.head(nVoiced).square().mean());
+    const double noiseRms = filteredRms * std::pow(10.0, -params.snr / 20);
+
+    for (int i = 0; i < nTotal; ++i) {
+        x(i) += noiseRms * normal(gen);
+    }
+
+    signal.samples = 0.5 * x / x.abs().maxCoeff();
+
+    return signal;
+}
+
+std::vector<Synth::Params> Synth::corpus(double sampleRate)
+{
+    // Adult male averages from Peterson & Barney (1952).
+    const struct {
+        const char * name;
+        std::array<double, NUM_FORMANTS> formants;
+    } vowels[] = {
+        {"a", {730, 1090, 2440}},
+        {"e", {530, 1840, 2480}},
+        {"i", {270, 2290, 3010}},
+        {"o", {570, 840, 2410}},
+        {"u", {300, 870, 2240}},
+    };
+
+    std::vector<Params> items;
+    unsigned seed = 1;
+
+    for (const auto & vowel : vowels) {
+        for (double f0 : {110.0, 160.0, 220.0}) {
+            for (double oq : {0.5, 0.7}) {
+                items.push_back({
+                    .name = std::string(vowel.name) + "-" + std::to_string(int(f0)) + "-oq" + std::to_string(int(oq * 10)),
+                    .sampleRate = sampleRate,
+                    .voicedDuration = 0.8,
+                    .unvoicedDuration = 0.2,
+                    .f0Start = f0,
+                    .f0End = 1.1 * f0,
+                    .openQuotient = oq,
+                    .jitter = 0.005,
+                    .shimmer = 0.03,
+                    .snr = 30,
+                    .formants = vowel.formants,
+                    .bandwidths = {80, 90, 120},
+                    // In back vowels, F1 and F2 are both below 1 kHz and the
+                    // LP analysis merges them into one peak.
+                    .scoreFormants = vowel.formants[1] > 1000,
+                    .seed = seed++,
+                });
+            }
+        }
+    }
+
+    return items;
+}
@@ -0,0 +1,59 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_SYNTH_H
+#define SPEECH_ANALYSIS_SYNTH_H
+
+#include <Eigen/Core>
+#include <array>
+#include <string>
+#include <vector>
+
+// Deterministic source-filter vowel synthesiser with known ground truth.
+//
+// A Rosenberg glottal pulse train, with jitter and shimmer, is differentiated
+// for lip radiation and passed through a cascade of formant resonators. The
+// vowel is followed by a stretch of breath noise through the same filter, so
+// that voicing decisions are checked too.
+
+namespace Synth {
+
+    constexpr int NUM_FORMANTS = 3;
+
+    struct Params {
+        std::string name;
+        double sampleRate;
+        // Voiced part, then unvoiced part, in seconds.
+        double voicedDuration;
+        double unvoicedDuration;
+        // F0 glides linearly from f0Start to f0End over the voiced part.
+        double f0Start;
+        double f0End;
+        double openQuotient;
+        // Standard deviations, relative to the period and to the amplitude.
+        double jitter;
+        double shimmer;
+        double snr;
+        std::array<double, NUM_FORMANTS> formants;
+        std::array<double, NUM_FORMANTS> bandwidths;
+        // Whether the formant tracker is expected to resolve these formants.
+        bool scoreFormants;
+        unsigned seed;
+    };
+
+    struct Signal {
+        Params params;
+        Eigen::ArrayXd samples;
+        // Nominal F0 at each sample, 0 where unvoiced.
+        Eigen::ArrayXd f0;
+    };
+
+    Signal generate(const Params & params);
+
+    // Five vowels at three pitches and two open quotients.
+    std::vector<Params> corpus(double sampleRate);
+
+}
+
+#endif //SPEECH_ANALYSIS_SYNTH_H
@@ -0,0 +1,188 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include "WavReader.h"
+#include "../audio/Downmix.h"
+#include "../Exceptions.h"
+
+using namespace WavReader;
+
+constexpr std::uint16_t WAVE_FORMAT_PCM = 0x0001;
+constexpr std::uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+constexpr std::uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+static std::vector<std::uint8_t> readFile(const std::string & path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw FileException("Unable to open input file");
+    }
+    return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), {});
+}
+
+static std::uint32_t le(const std::uint8_t * p, int nbytes)
+{
+    std::uint32_t v = 0;
+    for (int i = 0; i < nbytes; ++i) {
+        v |= std::uint32_t(p[i]) << (8 * i);
+    }
+    return v;
+}
+
+// Converts `count` little-endian samples to float in [-1, 1].
+static void decode(const std::uint8_t * in, std::size_t count, int bitsPerSample, bool isFloat, float * out)
+{
+    const int bytes = bitsPerSample / 8;
+
+    for (std::size_t i = 0; i < count; ++i, in += bytes) {
+        if (isFloat && bytes == 4) {
+            std::uint32_t u = le(in, 4);
+            float f;
+            std::memcpy(&f, &u, 4);
+            out[i] = f;
+        }
+        else if (isFloat && bytes == 8) {
+            std::uint64_t u = le(in, 4) | (std::uint64_t(le(in + 4, 4)) << 32);
+            double d;
+            std::memcpy(&d, &u, 8);
+            out[i] = float(d);
+        }
+        else if (bytes == 1) {
+            // 8-bit PCM is unsigned.
+            out[i] = (float(in[0]) - 128.0f) / 128.0f;
+        }
+        else {
+            // Sign-extend from the top byte.
+            const std::uint32_t u = le(in, bytes) << (32 - bitsPerSample);
+            out[i] = float(std::int32_t(u)) / 2147483648.0f;
+        }
+    }
+}
+
+Audio WavReader::read(const std::string & path)
+{
+    const std::vector<std::uint8_t> bytes = readFile(path);
+    const std::uint8_t * p = bytes.data();
+    const std::size_t size = bytes.size();
+
+    if (size < 12 || std::memcmp(p, "RIFF", 4) != 0 || std::memcmp(p + 8, "WAVE", 4) != 0) {
+        throw FileException("Not a RIFF/WAVE file");
+    }
+
+    bool hasFormat = false;
+    std::uint16_t formatTag = 0;
+    int numChannels = 0;
+    double sampleRate = 0;
+    int bitsPerSample = 0;
+
+    std::size_t pos = 12;
+
+    while (pos + 8 <= size) {
+        const std::uint8_t * chunk = p + pos;
+        const std::size_t chunkSize = le(chunk + 4, 4);
+        const std::size_t available = std::min(chunkSize, size - pos - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            if (available < 16) {
+                throw FileException("Truncated fmt chunk");
+            }
+            formatTag = le(chunk + 8, 2);
+            numChannels = le(chunk + 10, 2);
+            sampleRate = le(chunk + 12, 4);
+            bitsPerSample = le(chunk + 22, 2);
+
+            if (formatTag == WAVE_FORMAT_EXTENSIBLE && available >= 40) {
+                // The first two bytes of the sub-format GUID hold the actual format tag.
+                formatTag = le(chunk + 32, 2);
+            }
+            hasFormat = true;
+        }
+        else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!hasFormat) {
+                throw FileException("data chunk before fmt chunk");
+            }
+
+            const bool isFloat = (formatTag == WAVE_FORMAT_IEEE_FLOAT);
+
+            if (numChannels <= 0 || sampleRate <= 0
+                    || (formatTag != WAVE_FORMAT_PCM && !isFloat)
+                    || (formatTag == WAVE_FORMAT_PCM && (bitsPerSample % 8 != 0 || bitsPerSample < 8 || bitsPerSample > 32))
+                    || (isFloat && bitsPerSample != 32 && bitsPerSample != 64)) {
+                throw FileException("Unsupported WAVE sample format");
+            }
+
+            const std::size_t frameBytes = std::size_t(numChannels) * (bitsPerSample / 8);
+            const std::size_t frameCount = available / frameBytes;
+
+            Audio audio;
+            audio.sampleRate = sampleRate;
+            audio.numChannels = numChannels;
+            audio.samples.resize(frameCount * numChannels);
+
+            decode(chunk + 8, audio.samples.size(), bitsPerSample, isFloat, audio.samples.data());
+
+            return audio;
+        }
+
+        // Chunks are padded to an even size.
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    throw FileException("No data chunk in WAVE file");
+}
+
+Audio WavReader::readRaw(const std::string & path, RawFormat format, int numChannels, double sampleRate)
+{
+    if (numChannels <= 0 || sampleRate <= 0) {
+        throw FileException("Invalid raw PCM layout");
+    }
+
+    const std::vector<std::uint8_t> bytes = readFile(path);
+
+    int bitsPerSample;
+    bool isFloat = false;
+
+    switch (format) {
+        case S16: bitsPerSample = 16; break;
+        case S24: bitsPerSample = 24; break;
+        case S32: bitsPerSample = 32; break;
+        case F32: bitsPerSample = 32; isFloat = true; break;
+        case F64: bitsPerSample = 64; isFloat = true; break;
+        default:
+            throw FileException("Unsupported raw PCM format");
+    }
+
+    const std::size_t frameBytes = std::size_t(numChannels) * (bitsPerSample / 8);
+    const std::size_t frameCount = bytes.size() / frameBytes;
+
+    Audio audio;
+    audio.sampleRate = sampleRate;
+    audio.numChannels = numChannels;
+    audio.samples.resize(frameCount * numChannels);
+
+    decode(bytes.data(), audio.samples.size(), bitsPerSample, isFloat, audio.samples.data());
+
+    return audio;
+}
+
+std::vector<float> WavReader::toMono(const Audio & audio)
+{
+    const int numChannels = audio.numChannels;
+    const int frameCount = audio.samples.size() / numChannels;
+
+    if (numChannels == 1) {
+        return audio.samples;
+    }
+
+    const std::vector<float> weights(numChannels, 1.0f / numChannels);
+
+    std::vector<float> mono(frameCount);
+    Downmix::mix(audio.samples.data(), numChannels, weights.data(), frameCount, mono.data());
+
+    return mono;
+}
@@ -0,0 +1,39 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#ifndef SPEECH_ANALYSIS_WAVREADER_H
+#define SPEECH_ANALYSIS_WAVREADER_H
+
+#include <string>
+#include <vector>
+
+namespace WavReader
+{
+    enum RawFormat {
+        S16 = 0,
+        S24,
+        S32,
+        F32,
+        F64,
+    };
+
+    struct Audio {
+        double sampleRate;
+        int numChannels;
+        // Interleaved samples.
+        std::vector<float> samples;
+    };
+
+    // RIFF/WAVE with integer PCM (8 to 32 bits) or IEEE float (32 or 64 bits).
+    // Throws FileException on malformed or unsupported files.
+    Audio read(const std::string & path);
+
+    // Headerless little-endian PCM.
+    Audio readRaw(const std::string & path, RawFormat format, int numChannels, double sampleRate);
+
+    // Averages all channels into one.
+    std::vector<float> toMono(const Audio & audio);
+}
+
+#endif //SPEECH_ANALYSIS_WAVREADER_H
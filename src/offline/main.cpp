@@ -0,0 +1,413 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "WavReader.h"
+#include "../analysis/AnalysisEngine.h"
+#include "../Exceptions.h"
+#include "../log/Trace.h"
+#include "FFT/FFT.h"
+#include "FFT/STFT.h"
+#include "Signal/Filter.h"
+
+using namespace Eigen;
+
+// As for the live spectrum.
+constexpr double preEmphasisFrequency = 150.0;
+
+struct Options {
+    int nfft = 512;
+    int lpOrder = 12;
+    int cepOrder = 15;
+    double maximumFrequency = 4700;
+    double frameLength = 35;
+    double frameSpace = 15;
+    PitchAlg pitchAlg = Wavelet;
+    FormantMethod formantMethod = KARMA;
+
+    bool raw = false;
+    WavReader::RawFormat rawFormat = WavReader::S16;
+    int rawChannels = 1;
+    double rawSampleRate = 16000;
+
+    int numWorkers = -1;
+    bool writeSpectrum = true;
+    FFTPlanning fftPlanning = FFTPlanEstimate;
+    std::string fftWisdomDir;
+    std::string traceFile;
+    std::string outputDir = ".";
+    std::vector<std::string> inputs;
+};
+
+struct Track {
+    double time;
+    double pitch;
+    double oq;
+    Formant::Frame formants;
+};
+
+static void usage(const char * argv0)
+{
+    std::cerr <<
+        "Usage: " << argv0 << " [options] file...\n"
+        "\n"
+        "Runs the speech analysis pipeline over audio files, frame by frame, as fast as possible.\n"
+        "For each input, writes <name>.tracks.csv and <name>.spectrum.npy to the output directory.\n"
+        "\n"
+        "Options:\n"
+        "  -o, --output DIR          output directory (default: .)\n"
+        "  --fft-size N              spectrum FFT size (default: 512)\n"
+        "  --lp-order N              linear prediction order (default: 12)\n"
+        "  --cep-order N             cepstral order for KARMA (default: 15)\n"
+        "  --max-freq HZ             maximum formant frequency (default: 4700)\n"
+        "  --frame-length MS         analysis frame length (default: 35)\n"
+        "  --frame-space MS          hop between frames (default: 15)\n"
+        "  --pitch-alg ALG           wavelet, mcleod, yin, amdf or yin-fast\n"
+        "                            (default: wavelet)\n"
+        "  --formant-method METHOD   lp or karma (default: karma)\n"
+        "  --raw FORMAT              read headerless PCM: s16, s24, s32, f32 or f64\n"
+        "  --raw-channels N          channel count of raw input (default: 1)\n"
+        "  --raw-rate HZ             sample rate of raw input (default: 16000)\n"
+        "  --workers N               analysis worker threads (default: up to 3)\n"
+        "  --no-spectrum             do not write the spectrum\n"
+        "  --fft-planning MODE       estimate, measure or patient (default: estimate)\n"
+        "  --fft-wisdom DIR          load and save FFTW wisdom in DIR\n"
+        "  --trace FILE              write a Chrome/Perfetto trace of the analysis stages\n"
+        "\n"
+        "Spectrum rows are frames of pre-emphasised Hanning-windowed magnitudes;\n"
+        "there are fft-size / 2 + 1 columns and column i is the frequency i * fs / fft-size.\n";
+}
+
+static bool parseArgs(int argc, char * argv[], Options & opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        }
+        else if (arg == "-o" || arg == "--output") {
+            opts.outputDir = value();
+        }
+        else if (arg == "--fft-size") {
+            opts.nfft = std::stoi(value());
+        }
+        else if (arg == "--lp-order") {
+            opts.lpOrder = std::stoi(value());
+        }
+        else if (arg == "--cep-order") {
+            opts.cepOrder = std::stoi(value());
+        }
+        else if (arg == "--max-freq") {
+            opts.maximumFrequency = std::stod(value());
+        }
+        else if (arg == "--frame-length") {
+            opts.frameLength = std::stod(value());
+        }
+        else if (arg == "--frame-space") {
+            opts.frameSpace = std::stod(value());
+        }
+        else if (arg == "--pitch-alg") {
+            const std::string v = value();
+            if (v == "wavelet")     opts.pitchAlg = Wavelet;
+            else if (v == "mcleod") opts.pitchAlg = McLeod;
+            else if (v == "yin")    opts.pitchAlg = YIN;
+            else if (v == "amdf")   opts.pitchAlg = AMDF;
+            else if (v == "yin-fast") opts.pitchAlg = FastYIN;
+            else throw std::invalid_argument("unknown pitch algorithm " + v);
+        }
+        else if (arg == "--formant-method") {
+            const std::string v = value();
+            if (v == "lp")         opts.formantMethod = LP;
+            else if (v == "karma") opts.formantMethod = KARMA;
+            else throw std::invalid_argument("unknown formant method " + v);
+        }
+        else if (arg == "--raw") {
+            const std::string v = value();
+            opts.raw = true;
+            if (v == "s16")      opts.rawFormat = WavReader::S16;
+            else if (v == "s24") opts.rawFormat = WavReader::S24;
+            else if (v == "s32") opts.rawFormat = WavReader::S32;
+            else if (v == "f32") opts.rawFormat = WavReader::F32;
+            else if (v == "f64") opts.rawFormat = WavReader::F64;
+            else throw std::invalid_argument("unknown raw format " + v);
+        }
+        else if (arg == "--raw-channels") {
+            opts.rawChannels = std::stoi(value());
+        }
+        else if (arg == "--raw-rate") {
+            opts.rawSampleRate = std::stod(value());
+        }
+        else if (arg == "--workers") {
+            opts.numWorkers = std::stoi(value());
+        }
+        else if (arg == "--no-spectrum") {
+            opts.writeSpectrum = false;
+        }
+        else if (arg == "--fft-planning") {
+            const std::string v = value();
+            if (v == "estimate")     opts.fftPlanning = FFTPlanEstimate;
+            else if (v == "measure") opts.fftPlanning = FFTPlanMeasure;
+            else if (v == "patient") opts.fftPlanning = FFTPlanPatient;
+            else throw std::invalid_argument("unknown FFT planning mode " + v);
+        }
+        else if (arg == "--fft-wisdom") {
+            opts.fftWisdomDir = value();
+        }
+        else if (arg == "--trace") {
+            opts.traceFile = value();
+        }
+        else if (!arg.empty() && arg[0] == '-') {
+            throw std::invalid_argument("unknown option " + arg);
+        }
+        else {
+            opts.inputs.push_back(arg);
+        }
+    }
+
+    if (opts.frameLength <= 0 || opts.frameSpace <= 0 || opts.nfft <= 0) {
+        throw std::invalid_argument("frame length, frame space and FFT size must be positive");
+    }
+
+    return !opts.inputs.empty();
+}
+
+static std::string outputStem(const Options & opts, const std::string & input)
+{
+    std::string name = input.substr(input.find_last_of("/\\") + 1);
+    const auto dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        name.erase(dot);
+    }
+    return opts.outputDir + "/" + name;
+}
+
+static void writeTracks(const std::string & path, const std::vector<Track> & tracks)
+{
+    std::ofstream file(path);
+    if (!file) {
+        throw FileException("Unable to open tracks output file");
+    }
+
+    int maxFormants = 0;
+    for (const auto & t : tracks) {
+        maxFormants = std::max(maxFormants, t.formants.nFormants);
+    }
+
+    file << "time,pitch,oq,nformants";
+    for (int i = 1; i <= maxFormants; ++i) {
+        file << ",f" << i << ",b" << i;
+    }
+    file << '\n';
+
+    char buf[64];
+
+    for (const auto & t : tracks) {
+        std::snprintf(buf, sizeof(buf), "%.6f,%.3f,%.4f,%d", t.time, t.pitch, t.oq, t.formants.nFormants);
+        file << buf;
+        for (int i = 0; i < maxFormants; ++i) {
+            if (i < t.formants.nFormants) {
+                std::snprintf(buf, sizeof(buf), ",%.3f,%.3f",
+                              t.formants.formant[i].frequency, t.formants.formant[i].bandwidth);
+                file << buf;
+            }
+            else {
+                file << ",,";
+            }
+        }
+        file << '\n';
+    }
+}
+
+// NumPy .npy version 1.0, little-endian float32, C order.
+// Each column of `data` is one row of the array.
+static void writeNpy(const std::string & path, const ArrayXXf & data)
+{
+    const int rows = data.cols();
+    const int cols = data.rows();
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw FileException("Unable to open spectrum output file");
+    }
+
+    std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': ("
+                         + std::to_string(rows) + ", " + std::to_string(cols) + "), }";
+
+    // Magic (6) + version (2) + header length (2) + header, padded to 64 bytes and newline-terminated.
+    const std::size_t total = 10 + header.size() + 1;
+    header.append((64 - total % 64) % 64, ' ');
+    header.push_back('\n');
+
+    const std::uint16_t headerLength = header.size();
+    const char preamble[10] = {
+        '\x93', 'N', 'U', 'M', 'P', 'Y', 1, 0,
+        char(headerLength & 0xFF), char(headerLength >> 8),
+    };
+
+    file.write(preamble, sizeof(preamble));
+    file.write(header.data(), header.size());
+    file.write(reinterpret_cast<const char *>(data.data()), data.size() * sizeof(float));
+}
+
+static void analyseFile(const Options & opts, const std::string & input)
+{
+    TRACE_SCOPE("analyseFile");
+
+    const WavReader::Audio audio = opts.raw
+            ? WavReader::readRaw(input, opts.rawFormat, opts.rawChannels, opts.rawSampleRate)
+            : WavReader::read(input);
+
+    const std::vector<float> mono = WavReader::toMono(audio);
+    const double fs = audio.sampleRate;
+    const int length = mono.size();
+
+    AnalysisEngine engine(fs, opts.numWorkers);
+    engine.setFftSize(opts.nfft);
+    engine.setLinearPredictionOrder(opts.lpOrder);
+    engine.setCepstralOrder(opts.cepOrder);
+    engine.setMaximumFrequency(opts.maximumFrequency);
+    engine.setPitchAlgorithm(opts.pitchAlg);
+    engine.setFormantMethod(opts.formantMethod);
+    // The spectra are taken from the whole file at once below.
+    engine.setSpectrumEnabled(false);
+
+    const int nfft = engine.getFftSize();
+    const int frameSamples = std::max<int>(1, opts.frameLength / 1000.0 * fs);
+    const int hop = std::max<int>(1, opts.frameSpace / 1000.0 * fs);
+
+    engine.prepareTransforms(frameSamples);
+
+    std::vector<Track> tracks;
+
+    // Frames are committed in order, so the index of the next track is its frame number.
+    engine.setFrameCallback([&](const AnalysisFrame & frame) {
+        const int end = frameSamples + tracks.size() * hop;
+
+        tracks.push_back({
+            .time = (end - frameSamples / 2.0) / fs,
+            .pitch = frame.pitch,
+            .oq = frame.oq,
+            .formants = frame.formants,
+        });
+    });
+
+    const int fftSamples = engine.getCaptureFftSize();
+
+    ArrayXd x(frameSamples);
+    ArrayXd x_fft(fftSamples);
+
+    // Frames end on a fixed hop grid in the input, as in the live analyser.
+    // Up to AnalysisEngine::FRAMES_IN_FLIGHT frames are analysed concurrently.
+    for (int end = frameSamples; end <= length; end += hop) {
+        for (int i = 0; i < frameSamples; ++i) {
+            x(i) = mono[end - frameSamples + i];
+        }
+        for (int i = 0; i < fftSamples; ++i) {
+            const int j = end - fftSamples + i;
+            x_fft(i) = j >= 0 ? mono[j] : 0.0;
+        }
+
+        engine.submit(x, x_fft);
+    }
+
+    engine.wait();
+
+    const std::string stem = outputStem(opts, input);
+
+    writeTracks(stem + ".tracks.csv", tracks);
+
+    if (opts.writeSpectrum) {
+        TRACE_SCOPE("STFT::compute");
+
+        // The whole file is transformed at once, over the same frames as the tracks.
+        ArrayXf signal = Map<const ArrayXf>(mono.data(), length);
+        Filter::preEmphasis(signal, fs, preEmphasisFrequency);
+
+        STFT stft(nfft, hop);
+        ArrayXXf magnitude;
+        stft.compute(signal, frameSamples - nfft, tracks.size(), magnitude);
+
+        writeNpy(stem + ".spectrum.npy", magnitude);
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    Options opts;
+
+    try {
+        if (!parseArgs(argc, argv, opts)) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception & e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Trace::setThreadName("main");
+    Trace::setEnabled(!opts.traceFile.empty());
+
+    fft_set_planning(opts.fftPlanning);
+
+    const std::string wisdomPath = opts.fftWisdomDir.empty() ? "" : fft_wisdom_path(opts.fftWisdomDir);
+    if (!wisdomPath.empty()) {
+        fft_load_wisdom(wisdomPath);
+    }
+
+    int status = EXIT_SUCCESS;
+
+    for (const auto & input : opts.inputs) {
+        using namespace std::chrono;
+
+        const auto t1 = steady_clock::now();
+
+        try {
+            analyseFile(opts, input);
+        }
+        catch (const std::exception & e) {
+            std::cerr << input << ": " << e.what() << std::endl;
+            status = EXIT_FAILURE;
+            continue;
+        }
+
+        const auto t2 = steady_clock::now();
+        std::cerr << input << ": done in " << duration_cast<milliseconds>(t2 - t1).count() << " ms" << std::endl;
+    }
+
+    if (!wisdomPath.empty() && !fft_save_wisdom(wisdomPath)) {
+        std::cerr << wisdomPath << ": unable to save FFTW wisdom" << std::endl;
+    }
+
+    if (!opts.traceFile.empty()) {
+        try {
+            Trace::writeJson(opts.traceFile);
+        }
+        catch (const std::exception & e) {
+            std::cerr << opts.traceFile << ": " << e.what() << std::endl;
+            status = EXIT_FAILURE;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,460 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Synth.h"
+#include "../analysis/AnalysisEngine.h"
+#include "../log/Trace.h"
+
+using namespace Eigen;
+
+struct Options {
+    double sampleRate = 16000;
+    double frameLength = 35;
+    double frameSpace = 15;
+    PitchAlg pitchAlg = Wavelet;
+    FormantMethod formantMethod = KARMA;
+    int numWorkers = -1;
+    // Frames at the start of each item are not scored while the trackers settle.
+    double settleTime = 0.1;
+
+    // Failure thresholds, in percent except for the open quotient. The defaults
+    // sit just above what the default settings achieve, so they catch
+    // regressions rather than measure quality. Formants are only scored on the
+    // front and open vowels, where the tracker resolves F1 and F2.
+    double maxVoicingError = 5;
+    double maxF0GrossError = 5;
+    double maxF0Error = 2;
+    std::array<double, Synth::NUM_FORMANTS> maxFormantError = {16, 12, 28};
+    double maxOqError = 0.15;
+    double minFramesPerSecond = 0;
+
+    bool verbose = false;
+    std::string jsonPath;
+};
+
+// Error sums over scored frames.
+struct Errors {
+    int frames = 0;
+    int voicingErrors = 0;
+
+    int voicedFrames = 0;
+    int f0Gross = 0;
+    double f0RelativeSum = 0;
+
+    std::array<int, Synth::NUM_FORMANTS> formantFrames{};
+    std::array<int, Synth::NUM_FORMANTS> formantMissing{};
+    std::array<double, Synth::NUM_FORMANTS> formantRelativeSum{};
+
+    int oqFrames = 0;
+    double oqAbsoluteSum = 0;
+
+    void add(const Errors & o) {
+        frames += o.frames;
+        voicingErrors += o.voicingErrors;
+        voicedFrames += o.voicedFrames;
+        f0Gross += o.f0Gross;
+        f0RelativeSum += o.f0RelativeSum;
+        for (int k = 0; k < Synth::NUM_FORMANTS; ++k) {
+            formantFrames[k] += o.formantFrames[k];
+            formantMissing[k] += o.formantMissing[k];
+            formantRelativeSum[k] += o.formantRelativeSum[k];
+        }
+        oqFrames += o.oqFrames;
+        oqAbsoluteSum += o.oqAbsoluteSum;
+    }
+
+    [[nodiscard]] double voicingErrorPercent() const {
+        return frames ? 100.0 * voicingErrors / frames : 0.0;
+    }
+    [[nodiscard]] double f0GrossPercent() const {
+        return voicedFrames ? 100.0 * f0Gross / voicedFrames : 0.0;
+    }
+    // Mean relative error of the frames without gross errors.
+    [[nodiscard]] double f0ErrorPercent() const {
+        const int fine = voicedFrames - f0Gross;
+        return fine ? 100.0 * f0RelativeSum / fine : 0.0;
+    }
+    // Missing formants count as 100 % off.
+    [[nodiscard]] double formantErrorPercent(int k) const {
+        const int n = formantFrames[k] + formantMissing[k];
+        return n ? 100.0 * (formantRelativeSum[k] + formantMissing[k]) / n : 0.0;
+    }
+    [[nodiscard]] double oqError() const {
+        return oqFrames ? oqAbsoluteSum / oqFrames : 0.0;
+    }
+};
+
+struct FrameResult {
+    double pitch;
+    double oq;
+    Formant::Frame formants;
+};
+
+static void usage(const char * argv0)
+{
+    std::cerr <<
+        "Usage: " << argv0 << " [options]\n"
+        "\n"
+        "Synthesises a vowel corpus with known F0, formants and open quotient, runs the\n"
+        "analysis over it and reports throughput, per-stage cost and errors. Exits with\n"
+        "a failure status if an error exceeds its threshold.\n"
+        "\n"
+        "Options:\n"
+        "  --sample-rate HZ          corpus sample rate (default: 16000)\n"
+        "  --pitch-alg ALG           wavelet, mcleod, yin, amdf or yin-fast\n"
+        "                            (default: wavelet)\n"
+        "  --formant-method METHOD   lp or karma (default: karma)\n"
+        "  --workers N               analysis worker threads (default: up to 3)\n"
+        "  --max-voicing-error PCT   (default: 5)\n"
+        "  --max-f0-gross-error PCT  frames more than 20 % off (default: 5)\n"
+        "  --max-f0-error PCT        mean error of the other frames (default: 2)\n"
+        "  --max-f1-error PCT        mean F1 error of front and open vowels (default: 16)\n"
+        "  --max-f2-error PCT        mean F2 error of front and open vowels (default: 12)\n"
+        "  --max-f3-error PCT        mean F3 error of front and open vowels (default: 28)\n"
+        "  --max-oq-error X          mean absolute open quotient error (default: 0.15)\n"
+        "  --min-fps N               minimum frames per second (default: none)\n"
+        "  --json FILE               also write the report as JSON\n"
+        "  -v, --verbose             report every item of the corpus\n";
+}
+
+static bool parseArgs(int argc, char * argv[], Options & opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("missing value for " + arg);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        }
+        else if (arg == "--sample-rate") {
+            opts.sampleRate = std::stod(value());
+        }
+        else if (arg == "--pitch-alg") {
+            const std::string v = value();
+            if (v == "wavelet")     opts.pitchAlg = Wavelet;
+            else if (v == "mcleod") opts.pitchAlg = McLeod;
+            else if (v == "yin")    opts.pitchAlg = YIN;
+            else if (v == "amdf")   opts.pitchAlg = AMDF;
+            else if (v == "yin-fast") opts.pitchAlg = FastYIN;
+            else throw std::invalid_argument("unknown pitch algorithm " + v);
+        }
+        else if (arg == "--formant-method") {
+            const std::string v = value();
+            if (v == "lp")         opts.formantMethod = LP;
+            else if (v == "karma") opts.formantMethod = KARMA;
+            else throw std::invalid_argument("unknown formant method " + v);
+        }
+        else if (arg == "--workers") {
+            opts.numWorkers = std::stoi(value());
+        }
+        else if (arg == "--max-voicing-error") {
+            opts.maxVoicingError = std::stod(value());
+        }
+        else if (arg == "--max-f0-gross-error") {
+            opts.maxF0GrossError = std::stod(value());
+        }
+        else if (arg == "--max-f0-error") {
+            opts.maxF0Error = std::stod(value());
+        }
+        else if (arg == "--max-f1-error") {
+            opts.maxFormantError[0] = std::stod(value());
+        }
+        else if (arg == "--max-f2-error") {
+            opts.maxFormantError[1] = std::stod(value());
+        }
+        else if (arg == "--max-f3-error") {
+            opts.maxFormantError[2] = std::stod(value());
+        }
+        else if (arg == "--max-oq-error") {
+            opts.maxOqError = std::stod(value());
+        }
+        else if (arg == "--min-fps") {
+            opts.minFramesPerSecond = std::stod(value());
+        }
+        else if (arg == "--json") {
+            opts.jsonPath = value();
+        }
+        else if (arg == "-v" || arg == "--verbose") {
+            opts.verbose = true;
+        }
+        else {
+            throw std::invalid_argument("unknown option " + arg);
+        }
+    }
+
+    return true;
+}
+
+// Analyses one item and returns the wall time spent in the analysis.
+static double analyseItem(const Options & opts, const Synth::Signal & signal, std::vector<FrameResult> & results)
+{
+    const double fs = signal.params.sampleRate;
+    const int length = signal.samples.size();
+
+    AnalysisEngine engine(fs, opts.numWorkers);
+    engine.setPitchAlgorithm(opts.pitchAlg);
+    engine.setFormantMethod(opts.formantMethod);
+
+    const int fftSamples = engine.getCaptureFftSize();
+    const int frameSamples = opts.frameLength / 1000.0 * fs;
+    const int hop = opts.frameSpace / 1000.0 * fs;
+
+    results.clear();
+
+    engine.setFrameCallback([&](const AnalysisFrame & frame) {
+        results.push_back({frame.pitch, frame.oq, frame.formants});
+    });
+
+    ArrayXd x(frameSamples);
+    ArrayXd x_fft(fftSamples);
+
+    engine.prepareTransforms(frameSamples);
+
+    const auto t1 = std::chrono::steady_clock::now();
+
+    // The same frame grid as the offline analyser.
+    for (int end = frameSamples; end <= length; end += hop) {
+        x = signal.samples.segment(end - frameSamples, frameSamples);
+        for (int i = 0; i < fftSamples; ++i) {
+            const int j = end - fftSamples + i;
+            x_fft(i) = j >= 0 ? signal.samples(j) : 0.0;
+        }
+        engine.submit(x, x_fft);
+    }
+
+    engine.wait();
+
+    const auto t2 = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(t2 - t1).count();
+}
+
+static Errors scoreItem(const Options & opts, const Synth::Signal & signal, const std::vector<FrameResult> & results)
+{
+    const double fs = signal.params.sampleRate;
+    const int frameSamples = opts.frameLength / 1000.0 * fs;
+    const int hop = opts.frameSpace / 1000.0 * fs;
+
+    Errors errors;
+
+    for (int k = 0; k < int(results.size()); ++k) {
+        const int end = frameSamples + k * hop;
+        const int centre = end - frameSamples / 2;
+
+        // Frames that straddle the end of the vowel have no single truth.
+        const bool voicedStart = signal.f0(end - frameSamples) > 0;
+        const bool voicedEnd = signal.f0(end - 1) > 0;
+        if (voicedStart != voicedEnd || centre < opts.settleTime * fs) {
+            continue;
+        }
+
+        const FrameResult & r = results[k];
+        const double f0 = signal.f0(centre);
+        const bool voiced = voicedStart;
+
+        errors.frames++;
+
+        if (voiced != (r.pitch > 0)) {
+            errors.voicingErrors++;
+        }
+
+        if (!voiced) {
+            continue;
+        }
+
+        if (r.pitch > 0) {
+            errors.voicedFrames++;
+
+            const double relative = std::abs(r.pitch - f0) / f0;
+            if (relative > 0.2) {
+                errors.f0Gross++;
+            }
+            else {
+                errors.f0RelativeSum += relative;
+            }
+        }
+
+        if (signal.params.scoreFormants) {
+            for (int i = 0; i < Synth::NUM_FORMANTS; ++i) {
+                if (i < r.formants.nFormants) {
+                    const double truth = signal.params.formants[i];
+                    errors.formantFrames[i]++;
+                    errors.formantRelativeSum[i] += std::abs(r.formants.formant[i].frequency - truth) / truth;
+                }
+                else {
+                    errors.formantMissing[i]++;
+                }
+            }
+        }
+
+        if (r.oq > 0) {
+            errors.oqFrames++;
+            errors.oqAbsoluteSum += std::abs(r.oq - signal.params.openQuotient);
+        }
+    }
+
+    return errors;
+}
+
+static void printErrors(const char * label, const Errors & e)
+{
+    std::printf("%-16s %6d %8.2f %8.2f %8.2f", label,
+                e.frames, e.voicingErrorPercent(), e.f0GrossPercent(), e.f0ErrorPercent());
+    for (int i = 0; i < Synth::NUM_FORMANTS; ++i) {
+        if (e.formantFrames[i] + e.formantMissing[i] > 0) {
+            std::printf(" %8.2f", e.formantErrorPercent(i));
+        }
+        else {
+            std::printf(" %8s", "-");
+        }
+    }
+    std::printf(" %8.3f\n", e.oqError());
+}
+
+int main(int argc, char * argv[])
+{
+    Options opts;
+
+    try {
+        if (!parseArgs(argc, argv, opts)) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const std::exception & e) {
+        std::cerr << argv[0] << ": " << e.what() << std::endl;
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Trace::setThreadName("main");
+    Trace::setEnabled(true);
+
+    Errors total;
+    int totalFrames = 0;
+    double totalSeconds = 0;
+    double audioSeconds = 0;
+
+    std::vector<FrameResult> results;
+
+    std::printf("%-16s %6s %8s %8s %8s %8s %8s %8s %8s\n",
+                "item", "frames", "voicing%", "f0gross%", "f0err%", "F1err%", "F2err%", "F3err%", "oqerr");
+
+    for (const auto & params : Synth::corpus(opts.sampleRate)) {
+        const Synth::Signal signal = Synth::generate(params);
+
+        try {
+            totalSeconds += analyseItem(opts, signal, results);
+        }
+        catch (const std::exception & e) {
+            std::cerr << params.name << ": " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        totalFrames += results.size();
+        audioSeconds += signal.samples.size() / params.sampleRate;
+
+        const Errors errors = scoreItem(opts, signal, results);
+        total.add(errors);
+
+        if (opts.verbose) {
+            printErrors(params.name.c_str(), errors);
+        }
+    }
+
+    printErrors("total", total);
+
+    const double fps = totalFrames / totalSeconds;
+
+    std::printf("\n%d frames in %.3f s: %.1f frames/s, %.1fx real time\n\n",
+                totalFrames, totalSeconds, fps, audioSeconds / totalSeconds);
+
+    // Stages may run concurrently, so their costs can add up to more than the wall time.
+    const auto stages = Trace::totals();
+
+    std::printf("%-36s %10s %12s\n", "stage", "calls", "us/frame");
+    for (const auto & stage : stages) {
+        std::printf("%-36s %10llu %12.1f\n", stage.name.c_str(),
+                    (unsigned long long) stage.count, 1000.0 * stage.totalMs / totalFrames);
+    }
+
+    struct Check {
+        const char * name;
+        const char * key;
+        double value;
+        double limit;
+        bool atMost;
+    };
+
+    const Check checks[] = {
+        {"voicing error %", "voicing_error_pct", total.voicingErrorPercent(), opts.maxVoicingError, true},
+        {"F0 gross error %", "f0_gross_error_pct", total.f0GrossPercent(), opts.maxF0GrossError, true},
+        {"F0 error %", "f0_error_pct", total.f0ErrorPercent(), opts.maxF0Error, true},
+        {"F1 error %", "f1_error_pct", total.formantErrorPercent(0), opts.maxFormantError[0], true},
+        {"F2 error %", "f2_error_pct", total.formantErrorPercent(1), opts.maxFormantError[1], true},
+        {"F3 error %", "f3_error_pct", total.formantErrorPercent(2), opts.maxFormantError[2], true},
+        {"OQ error", "oq_error", total.oqError(), opts.maxOqError, true},
+        {"frames/s", nullptr, fps, opts.minFramesPerSecond, false},
+    };
+
+    bool failed = false;
+
+    std::printf("\n");
+    for (const auto & check : checks) {
+        const bool ok = check.atMost ? check.value <= check.limit : check.value >= check.limit;
+        if (!ok) {
+            std::printf("FAIL: %s is %.3f, %s %.3f\n", check.name, check.value,
+                        check.atMost ? "above" : "below", check.limit);
+            failed = true;
+        }
+    }
+    if (!failed) {
+        std::printf("PASS\n");
+    }
+
+    if (!opts.jsonPath.empty()) {
+        std::ofstream file(opts.jsonPath);
+        if (!file) {
+            std::cerr << argv[0] << ": unable to open " << opts.jsonPath << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        char buf[128];
+
+        file << "{\n";
+        std::snprintf(buf, sizeof(buf), "  \"frames\": %d,\n  \"seconds\": %.6f,\n  \"frames_per_second\": %.2f,\n",
+                      totalFrames, totalSeconds, fps);
+        file << buf;
+        file << "  \"errors\": {";
+        for (std::size_t i = 0; i + 1 < std::size(checks); ++i) {
+            std::snprintf(buf, sizeof(buf), "%s\n    \"%s\": %.4f", i == 0 ? "" : ",", checks[i].key, checks[i].value);
+            file << buf;
+        }
+        file << "\n  },\n  \"stages_us_per_frame\": {";
+        for (std::size_t i = 0; i < stages.size(); ++i) {
+            std::snprintf(buf, sizeof(buf), "%s\n    \"%s\": %.2f", i == 0 ? "" : ",",
+                          stages[i].name.c_str(), 1000.0 * stages[i].totalMs / totalFrames);
+            file << buf;
+        }
+        file << "\n  },\n  \"pass\": " << (failed ? "false" : "true") << "\n}\n";
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
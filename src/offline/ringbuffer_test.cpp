@@ -0,0 +1,192 @@
+//
+// Created by clo on 14/04/2020.
+//
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "../audio/RingBuffer.h"
+
+using namespace Eigen;
+
+// Every sample holds its position in the stream, so that any sample read
+// from the wrong place is seen.
+static float sampleAt(std::uint64_t position)
+{
+    return static_cast<float>(position % 65536);
+}
+
+static void produce(RingBuffer & buffer, std::uint64_t & position, int count)
+{
+    std::vector<float> block(count);
+    for (int i = 0; i < count; ++i) {
+        block[i] = sampleAt(position + i);
+    }
+    buffer.writeInto(block.data(), count);
+    position += count;
+}
+
+static bool holds(const ArrayXf & out, std::uint64_t position)
+{
+    for (int i = 0; i < out.size(); ++i) {
+        if (out(i) != sampleAt(position + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int failures = 0;
+
+static void check(bool condition, const char * what)
+{
+    if (!condition) {
+        std::printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void testWraparound()
+{
+    RingBuffer buffer(64);
+    std::uint64_t position = 0;
+    ArrayXf out(50);
+
+    // Blocks that are not a divisor of the capacity cross its end at every
+    // offset.
+    for (int k = 0; k < 40; ++k) {
+        produce(buffer, position, 37);
+        if (position >= 50) {
+            check(buffer.readFrom(out) && holds(out, position - 50), "wraparound: readFrom");
+        }
+    }
+
+    // Only the newest samples of a block larger than the buffer are kept.
+    produce(buffer, position, 100);
+    ArrayXf all(64);
+    check(buffer.readAt(position - 64, all) && holds(all, position - 64), "wraparound: oversized block");
+
+    check(buffer.getOverrunCount() == 0, "wraparound: no overrun");
+    check(buffer.getUnderrunCount() == 0, "wraparound: no underrun");
+}
+
+static void testOverrun()
+{
+    RingBuffer buffer(64);
+    std::uint64_t position = 0;
+    produce(buffer, position, 200);
+
+    ArrayXf out(32);
+    check(!buffer.readAt(0, out) && (out == 0).all(), "overrun: lost block is zeroed");
+    check(buffer.getOverrunCount() == 1, "overrun: counted once");
+
+    // Half lost: the lost half is zeroed and the rest is intact.
+    check(!buffer.readAt(position - 64 - 16, out), "overrun: partly lost block");
+    check((out.head(16) == 0).all() && holds(out.tail(16), position - 64), "overrun: partly lost block content");
+    check(buffer.getOverrunCount() == 2, "overrun: counted twice");
+}
+
+static void testUnderrun()
+{
+    RingBuffer buffer(64);
+    std::uint64_t position = 0;
+    ArrayXf out(32);
+
+    // The startup fill is not an underrun.
+    produce(buffer, position, 10);
+    check(!buffer.readFrom(out), "underrun: startup read is incomplete");
+    check(buffer.getUnderrunCount() == 0, "underrun: startup not counted");
+
+    produce(buffer, position, 30);
+    check(buffer.readFrom(out) && holds(out, position - 32), "underrun: first full read");
+
+    // Reading ahead of the producer is.
+    check(!buffer.readAt(position - 16, out), "underrun: read ahead is incomplete");
+    check(holds(out.head(16), position - 16) && (out.tail(16) == 0).all(), "underrun: read ahead content");
+    check(buffer.getUnderrunCount() == 1, "underrun: read ahead counted");
+}
+
+static void testResize()
+{
+    RingBuffer buffer(64);
+    std::uint64_t position = 0;
+    produce(buffer, position, 100);
+
+    // Growing the buffer discards what it held, without moving the positions.
+    buffer.setCapacity(256);
+    check(buffer.getWritePosition() == position, "resize: write position kept");
+    check(buffer.getOldestPosition() == position, "resize: nothing held");
+
+    ArrayXf out(32);
+    check(!buffer.readAt(position - 32, out) && (out == 0).all(), "resize: discarded block is not read");
+    check(buffer.getOverrunCount() == 1, "resize: discarded block counted as lost");
+
+    produce(buffer, position, 20);
+    check(!buffer.readFrom(out) && holds(out.tail(20), position - 20), "resize: partly discarded block");
+
+    produce(buffer, position, 300);
+    check(buffer.getOldestPosition() == position - 256, "resize: oldest follows the capacity again");
+    check(buffer.readFrom(out) && holds(out, position - 32), "resize: reads after refill");
+}
+
+static void testConcurrent()
+{
+    // A small buffer and a reader that lags behind, so that the producer
+    // laps it in the middle of some copies.
+    RingBuffer buffer(256);
+    std::atomic<bool> done(false);
+
+    std::thread producer([&]() {
+        std::uint64_t position = 0;
+        for (int k = 0; k < 200000; ++k) {
+            produce(buffer, position, 1 + k % 61);
+        }
+        done = true;
+    });
+
+    ArrayXf out(200);
+    int complete = 0, incomplete = 0, torn = 0;
+
+    while (!done) {
+        const std::uint64_t w = buffer.getWritePosition();
+        if (w < 300) {
+            continue;
+        }
+        const std::uint64_t position = w - 250;
+        if (buffer.readAt(position, out)) {
+            complete++;
+            if (!holds(out, position)) {
+                torn++;
+            }
+        }
+        else {
+            incomplete++;
+        }
+    }
+
+    producer.join();
+
+    std::printf("concurrent: %d complete, %d incomplete reads, %llu overruns\n",
+                complete, incomplete, (unsigned long long) buffer.getOverrunCount());
+
+    check(torn == 0, "concurrent: a read reported complete was torn");
+    check(buffer.getOverrunCount() >= (std::uint64_t) incomplete, "concurrent: incomplete reads counted as overruns");
+}
+
+int main()
+{
+    testWraparound();
+    testOverrun();
+    testUnderrun();
+    testResize();
+    testConcurrent();
+
+    if (failures > 0) {
+        return EXIT_FAILURE;
+    }
+
+    std::printf("PASS\n");
+    return EXIT_SUCCESS;
+}